@@ -0,0 +1,67 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+
+#include "Classes/UCVUMat.h"
+
+#include "CVAsyncReadTexture.generated.h"
+
+class UTexture;
+class UVolumeTexture;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FCVAsyncReadTextureDelegate, UCVUMat*, mat);
+
+/**
+ * Latent Blueprint node that reads a texture or render target back into a UCVUMat without
+ * blocking the game thread. The result arrives a couple of frames later, see FCVTextureReadback.
+ */
+UCLASS()
+class OPENCV_API UCVAsyncReadTexture : public UBlueprintAsyncActionBase {
+  GENERATED_BODY()
+
+public:
+  // Called with the read back matrix once the readback completed
+  UPROPERTY(BlueprintAssignable)
+  FCVAsyncReadTextureDelegate OnCompleted;
+
+  // Called if the readback could not be started or failed
+  UPROPERTY(BlueprintAssignable)
+  FCVAsyncReadTextureDelegate OnFailed;
+
+  /**
+   * Read the texture back into mat asynchronously. If mat is empty, a new UCVUMat will be created.
+   */
+  UFUNCTION(BlueprintCallable,
+            meta = (BlueprintInternalUseOnly = "true", WorldContext = "worldContextObject",
+                    DisplayName = "Create CVUMat from Texture2D (Async)"),
+            Category = "OpenCV|Core")
+  static UCVAsyncReadTexture* ReadTextureAsync(UObject* worldContextObject, UTexture* texture,
+                                               UCVUMat* mat);
+
+  /**
+   * Read the volume texture into a 3D mat asynchronously. Textures with CPU backing are copied
+   * right away like FromVolumeTexture does, others are read back from the GPU slab by slab (see
+   * FCVTextureReadback::EnqueueVolume for the supported formats).
+   */
+  UFUNCTION(BlueprintCallable,
+            meta = (BlueprintInternalUseOnly = "true", WorldContext = "worldContextObject",
+                    DisplayName = "Create CVUMat from Texture3D (Async)"),
+            Category = "OpenCV|Core")
+  static UCVAsyncReadTexture* ReadVolumeTextureAsync(UObject* worldContextObject,
+                                                     UVolumeTexture* texture, UCVUMat* mat);
+
+  virtual void Activate() override;
+
+private:
+  void OnReadbackComplete(bool bSuccess, cv::UMat Result);
+
+  UPROPERTY()
+  UTexture* Texture;
+
+  UPROPERTY()
+  UCVUMat* Mat;
+};
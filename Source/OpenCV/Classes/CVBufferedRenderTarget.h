@@ -0,0 +1,66 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+
+#include "CVBufferedRenderTarget.generated.h"
+
+class UCVUMat;
+class UTextureRenderTarget2D;
+
+/**
+ * A small ring of render targets for pipelined uploads.
+ * Every upload goes into the next render target of the ring, so materials can keep sampling the
+ * most recent completed frame while the render thread writes the next one. Each upload gets a
+ * frame index; once the render thread has submitted the texture update for a frame, that frame
+ * and its render target are published as completed.
+ */
+UCLASS(BlueprintType)
+class OPENCV_API UCVBufferedRenderTarget : public UObject {
+  GENERATED_BODY()
+
+public:
+  UCVBufferedRenderTarget();
+
+  /** Create a ring of numBuffers render targets (at least 2) */
+  UFUNCTION(BlueprintCallable, meta = (DisplayName = "Create Buffered Render Target"),
+            Category = "OpenCV|Core")
+  static UCVBufferedRenderTarget* Create(int32 numBuffers = 2);
+
+  /**
+   * Upload mat into the next render target of the ring. Returns the frame index of this upload,
+   * which can be polled with IsFrameComplete. Returns 0 if nothing was uploaded.
+   */
+  UFUNCTION(BlueprintCallable, Category = "OpenCV|Core")
+  int32 Upload(UCVUMat* mat, bool resize);
+
+  /** The render target holding the most recent completed upload, or nullptr if there is none */
+  UFUNCTION(BlueprintPure, Category = "OpenCV|Core")
+  UTextureRenderTarget2D* GetLatestCompleted() const;
+
+  /** Frame index of the most recent completed upload, 0 if none has completed yet */
+  UFUNCTION(BlueprintPure, Category = "OpenCV|Core")
+  int32 GetLatestCompletedFrame() const { return CompletedFrame->GetValue(); }
+
+  UFUNCTION(BlueprintPure, Category = "OpenCV|Core")
+  bool IsFrameComplete(int32 frameIndex) const { return frameIndex <= GetLatestCompletedFrame(); }
+
+  // The render targets of the ring
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|Core")
+  TArray<UTextureRenderTarget2D*> RenderTargets;
+
+private:
+  int32 GetLatestCompletedBuffer() const;
+
+  // Frame index that was last uploaded into each of the render targets
+  TArray<int32> BufferFrames;
+
+  int32 LastFrame;
+  int32 NextBuffer;
+
+  // Written by the render thread once the upload of a frame has been submitted
+  TSharedRef<FThreadSafeCounter, ESPMode::ThreadSafe> CompletedFrame;
+};
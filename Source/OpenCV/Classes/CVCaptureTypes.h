@@ -0,0 +1,153 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "CVCaptureTypes.generated.h"
+
+class UCVUMat;
+
+// How captured frames are queued between the capture thread and their consumer
+UENUM(BlueprintType)
+enum class ECVFrameQueuePolicy : uint8 {
+  // Always deliver the most recent frame, older ones are dropped (minimum latency)
+  LatestOnly,
+  // Deliver every frame; the capture thread waits while the queue is full (no frame loss)
+  FifoBackpressure,
+  // Deliver frames in order, but drop the oldest queued frame when the queue is full
+  FifoDropOldest,
+};
+
+// How video files are paced during playback
+UENUM(BlueprintType)
+enum class ECVPlaybackPacing : uint8 {
+  // Read at most RefreshRate frames per second, every frame is retrieved and published
+  RefreshRate,
+  // Follow the timestamps of the file in real time. Frames that are already late, or that newer
+  // frames would replace before the consumer picks them up, are grabbed but never retrieved, so
+  // they skip the colour conversion, resizing and processing.
+  // Files without a frame rate fall back to RefreshRate for the frame duration.
+  FileTimestamps,
+};
+
+// One stream of an ACVCaptureManager
+USTRUCT(BlueprintType)
+struct FCVCaptureStreamConfig {
+  GENERATED_BODY()
+
+  // The device ID to open, a negative ID opens VideoFile instead
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  int32 CameraID = 0;
+
+  // The video file opened if CameraID is negative
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  FString VideoFile;
+};
+
+// Frames of all streams of an ACVCaptureManager that were captured at (nearly) the same time
+USTRUCT(BlueprintType)
+struct FCVFrameSet {
+  GENERATED_BODY()
+
+  // One frame per stream, in the order of the manager's streams
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  TArray<UCVUMat*> Frames;
+
+  // Capture time of each frame in seconds since the manager started capturing
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  TArray<float> CaptureTimes;
+
+  // Difference between the earliest and the latest capture time of the set in seconds
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  float Spread = 0.f;
+};
+
+// Operations of the per-frame processing chain of AVideoCapture
+UENUM(BlueprintType)
+enum class ECVProcessingOperation : uint8 {
+  // Gaussian blur with Sigma (see UOpenCV_ImageProcessing::gaussianFilter)
+  GaussianFilter,
+  // Median blur with FilterSize (see UOpenCV_ImageProcessing::medianFilter)
+  MedianFilter,
+  // Bilateral filter with Diameter, SigmaColor and SigmaSpace
+  BilateralFilter,
+  // Removes lens distortion given the camera intrinsics
+  Undistort,
+  // Color space conversion with a cv::cvtColor code
+  ConvertColor,
+};
+
+// A stage of the per-frame processing chain of AVideoCapture
+USTRUCT(BlueprintType)
+struct FCVProcessingStage {
+  GENERATED_BODY()
+
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  ECVProcessingOperation Operation = ECVProcessingOperation::GaussianFilter;
+
+  // Standard deviation of the Gaussian filter in pixels
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  float Sigma = 1.f;
+
+  // Aperture of the median filter, odd and larger than 1
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  int32 FilterSize = 3;
+
+  // Parameters of the bilateral filter
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  int32 Diameter = 5;
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  float SigmaColor = 50.f;
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  float SigmaSpace = 50.f;
+
+  // Camera intrinsics for undistortion, in pixels of the image the stage receives
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  FVector2D FocalLength = FVector2D(1, 1);
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  FVector2D PrincipalPoint = FVector2D(0, 0);
+
+  // OpenCV distortion coefficients (k1, k2, p1, p2[, k3, ...]): none, 4, 5, 8, 12 or 14 values
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  TArray<float> DistortionCoefficients;
+
+  // The cv::ColorConversionCodes value, e.g. 6 for COLOR_BGR2GRAY
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  int32 ColorConversion = 6;
+};
+
+// Time in milliseconds a frame spent in each step between the camera and the texture
+USTRUCT(BlueprintType)
+struct FCVFrameLatency {
+  GENERATED_BODY()
+
+  // Grab to retrieved/decoded image
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  float DecodeMs = 0.f;
+
+  // Resizing on the capture thread
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  float ResizeMs = 0.f;
+
+  // The processing chain, including color conversions
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  float ProcessMs = 0.f;
+
+  // Published by the capture thread until picked up by the game thread
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  float QueueMs = 0.f;
+
+  // Picked up until the texture upload is enqueued, including the conversion to the texture format
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  float UploadMs = 0.f;
+
+  // Upload enqueued until the render thread has executed the texture update
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  float RenderMs = 0.f;
+
+  // Grab until the texture update was executed
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  float TotalMs = 0.f;
+};
@@ -0,0 +1,107 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "RenderCommandFence.h"
+
+#include "Classes/UCVUMat.h"
+
+#include "CVVolumeStreamingUpload.generated.h"
+
+class UVolumeTexture;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FCVVolumeStreamingUploadDelegate, UVolumeTexture*,
+                                             volumeTexture, float, progress);
+
+/**
+ * Latent Blueprint node that uploads a 3D UCVUMat into a volume texture over several frames.
+ * The volume is split into bricks, and every frame only as many bricks are uploaded as fit into
+ * the byte and time budgets, so large volumes can be loaded while the scene stays interactive.
+ *
+ * If the target texture does not match the volume, a new one is created once up front, without
+ * mips and without initial data. Bricks are written in place with RHIUpdateTexture3D, lower mips of
+ * an existing texture are not updated. The texture's CPU copy (mip bulk data) is only allocated and
+ * kept in sync if requested.
+ *
+ * The volume is not copied: the matrix must not be modified until the upload has finished.
+ */
+UCLASS()
+class OPENCV_API UCVVolumeStreamingUpload : public UBlueprintAsyncActionBase {
+  GENERATED_BODY()
+
+public:
+  // Called every frame in which bricks were uploaded, with the fraction of the volume done so far
+  UPROPERTY(BlueprintAssignable)
+  FCVVolumeStreamingUploadDelegate OnProgress;
+
+  // Called once the render thread has submitted all bricks
+  UPROPERTY(BlueprintAssignable)
+  FCVVolumeStreamingUploadDelegate OnCompleted;
+
+  // Called if the upload could not be started or was cancelled
+  UPROPERTY(BlueprintAssignable)
+  FCVVolumeStreamingUploadDelegate OnFailed;
+
+  /**
+   * Stream mat into volumeTexture (a new texture is created if it is empty or does not match).
+   * Every frame, bricks of brickSize^3 voxels are uploaded until kiloBytesPerFrame have been
+   * enqueued or millisecondsPerFrame have been spent on the game thread, but at least one brick.
+   * A budget of 0 disables that limit. If keepCpuCopy is set, the bricks are also written to the
+   * texture's bulk data (e.g. for FromVolumeTexture), at the cost of a second copy of the volume.
+   * mat must not be modified until the upload has finished.
+   */
+  UFUNCTION(BlueprintCallable,
+            meta = (BlueprintInternalUseOnly = "true", WorldContext = "worldContextObject",
+                    DisplayName = "Stream CVUMat to Texture3D"),
+            Category = "OpenCV|Core")
+  static UCVVolumeStreamingUpload* StreamToVolumeTexture(UObject* worldContextObject,
+                                                         UCVUMat* mat,
+                                                         UVolumeTexture* volumeTexture,
+                                                         int32 brickSize = 64,
+                                                         int32 kiloBytesPerFrame = 16384,
+                                                         float millisecondsPerFrame = 4.f,
+                                                         bool keepCpuCopy = false);
+
+  virtual void Activate() override;
+
+  /** Fraction of the volume that has been enqueued for upload, in [0, 1] */
+  UFUNCTION(BlueprintPure, Category = "OpenCV|Core")
+  float GetProgress() const;
+
+  /** Stop uploading further bricks. OnFailed is called with the partially updated texture. */
+  UFUNCTION(BlueprintCallable, Category = "OpenCV|Core")
+  void Cancel();
+
+  // The texture that is being uploaded to
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|Core")
+  UVolumeTexture* VolumeTexture;
+
+private:
+  bool Tick(float DeltaTime);
+  void Finish(bool bSuccess);
+
+  UPROPERTY()
+  UCVUMat* Mat;
+
+  int32 BrickSize;
+  int64 BytesPerFrame;
+  double SecondsPerFrame;
+  bool bKeepCpuCopy;
+
+  // Shares the memory of Mat->m (no copy is made); keeps it alive even if Mat is reassigned
+  cv::UMat Volume;
+  cv::Mat VolumeMapped;
+
+  FIntVector NumBricks;
+  int32 NextBrick;
+  int64 UploadedBytes;
+  int64 TotalBytes;
+
+  // Signals that the render thread has processed the last brick
+  FRenderCommandFence CompletionFence;
+  bool bAllBricksEnqueued;
+  FDelegateHandle TickHandle;
+};
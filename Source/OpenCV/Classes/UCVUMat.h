@@ -15,6 +15,8 @@ class FTextureRenderTarget2DResource;
 class FTexture2DResource;
 struct FUpdateTextureRegion2D;
 class UTextureRenderTarget2D;
+class UCVBufferedRenderTarget;
+class UTexture;
 class UTexture2D;
 class UVolumeTexture;
 
@@ -29,6 +31,43 @@ enum class FCVMatType : uint8 {
   CVT_8UC3 UMETA(DisplayName = "CV_8UC3"),
   CVT_8UC4 UMETA(DisplayName = "CV_8UC4"),
   CVT_UNKNOWN UMETA(DisplayName = "Unknown"),
+  // New types are appended so the values saved in existing assets keep their meaning
+  CVT_32FC1 UMETA(DisplayName = "CV_32FC1"),
+};
+
+// Filter used to build the mip chain of volume textures
+UENUM(BlueprintType)
+enum class ECVVolumeMipFilter : uint8 {
+  // Upload only the full resolution level
+  None,
+  // 2x2x2 average
+  Box,
+  // Separable 5-tap binomial filter, smoother but about twice as expensive
+  Gaussian,
+};
+
+/**
+ * Usage statistics of the staging memory pool that backs the texture uploads
+ */
+USTRUCT(BlueprintType)
+struct OPENCV_API FCVStagingPoolStats {
+  GENERATED_BODY()
+
+  // Number of uploads that were served from pooled memory
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|Core")
+  int32 Hits = 0;
+
+  // Number of uploads that had to allocate new staging memory
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|Core")
+  int32 Misses = 0;
+
+  // Memory currently held by the pool, in kilobytes
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|Core")
+  int32 PooledKiloBytes = 0;
+
+  // High-water mark of the pool, in megabytes
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|Core")
+  int32 MaxPooledMegaBytes = 0;
 };
 
 /**
@@ -44,6 +83,28 @@ public:
 
   cv::UMat m;
 
+  /**
+   * If set, ToTexture/ToRenderTarget compare the matrix against the previous upload to the same
+   * texture in tiles of ChangedTileSize and only upload the tiles that changed.
+   * This keeps a CPU copy of the last upload around. If another UCVUMat uploaded to the texture
+   * in between, the whole texture is uploaded again; writes that do not go through a UCVUMat
+   * (e.g. scene captures into the render target) are not detected.
+   */
+  UPROPERTY(BlueprintReadWrite, Category = "OpenCV|Core")
+  bool bUploadChangedTilesOnly = false;
+
+  // Tile size in pixels used by bUploadChangedTilesOnly
+  UPROPERTY(BlueprintReadWrite, Category = "OpenCV|Core")
+  int32 ChangedTileSize = 64;
+
+  /**
+   * If not None, ToVolumeTexture and ToVolumeTextureWindowed build the full mip chain of the
+   * volume on the CPU (down to 1x1x1) and upload all levels. ToVolumeTextureSlices only updates
+   * mip 0.
+   */
+  UPROPERTY(BlueprintReadWrite, Category = "OpenCV|Core")
+  ECVVolumeMipFilter VolumeMipFilter = ECVVolumeMipFilter::None;
+
   UFUNCTION(BlueprintPure) int32 GetRows() { return m.rows; };
   UFUNCTION(BlueprintPure) int32 GetCols() { return m.cols; };
   UFUNCTION(BlueprintPure) int32 GetChannels() { return m.channels(); };
@@ -58,10 +119,32 @@ public:
   static UCVUMat* CreateMat(int32 rows, int32 cols, FCVMatType type = FCVMatType::CVT_EMPTY,
                             UCVUMat* existingMat = nullptr);
 
+  /**
+   * Load a raw volume file (voxels in x-fastest order, little endian) as a 3D matrix of the given
+   * type, skipping headerSize bytes at the start of the file (-1 to take the data from the end).
+   * The file is memory mapped where possible instead of being read, so the matrix is read-only:
+   * clone it before modifying it. Returns nullptr if the file could not be loaded.
+   */
+  UFUNCTION(BlueprintCallable, meta = (DisplayName = "Load Raw Volume"), Category = "OpenCV|Core")
+  static UCVUMat* LoadRawVolume(const FString& fileName, FIntVector dimensions, FCVMatType type,
+                                int32 headerSize = 0);
+
+  /**
+   * Load an uncompressed 3D MetaImage volume (.mhd + data file, or .mha) like LoadRawVolume.
+   * spacing receives the voxel spacing from the header. Note that MET_SHORT volumes (e.g. CT) are
+   * loaded as CV_16SC1 integers, upload them with ToVolumeTextureWindowed.
+   */
+  UFUNCTION(BlueprintCallable, meta = (DisplayName = "Load MetaImage Volume"),
+            Category = "OpenCV|Core")
+  static UCVUMat* LoadMetaImage(const FString& fileName, FVector& spacing);
+
   /**
    * Convert/upload the UCVMat to the render target.
-   * If no renderTarget is given, a new one will be created. If resize = true, will resize the
-   * UCVMat to the dimensions of the renderTarget
+   * If no renderTarget is given, a new one will be created. If resize = true, the image is resized
+   * to the dimensions of the renderTarget during the upload (the UCVMat itself is not modified)
+   * Single-channel CV_8U, CV_16U and CV_32F matrices are uploaded to PF_G8, PF_G16 and
+   * PF_R32_FLOAT targets without channel expansion, color matrices to BGRA.
+   * CV_8UC4 matrices are uploaded without an intermediate copy, see ToTexture.
    */
   UFUNCTION(BlueprintCallable, meta = (DisplayName = "Copy CVUMat to Render Target"),
             Category = "OpenCV|Core")
@@ -69,26 +152,132 @@ public:
 
   /**
    * Convert/upload the UCVMat to a texture.
-   * If no renderTarget is given, a new one will be created. If resize = true, will resize the
-   * UCVMat to the dimensions of the renderTarget
+   * If no texture is given, a new one will be created. If resize = true, the image is resized
+   * to the dimensions of the texture during the upload (the UCVMat itself is not modified)
+   *
+   * NOTE: If OpenCV.ZeroCopyUpload is enabled (off by default) and the matrix layout matches
+   * the texture format (e.g. CV_8UC4 -> BGRA), the render thread reads directly from the matrix
+   * memory. Assign a new matrix instead of writing into the existing one in place if you need
+   * the previous upload to be unaffected. Matrices held in OpenCL buffers are always copied.
+   * Non-continuous matrices (e.g. ROIs of a larger frame) can be uploaded directly, there is no
+   * need to clone them first.
    */
   UFUNCTION(BlueprintCallable, meta = (DisplayName = "Copy CVUMat to Texture2D"),
             Category = "OpenCV|Core")
   void ToTexture(UPARAM(ref) UTexture2D*& texture, bool resize);
 
+  /**
+   * Upload the UCVMat into the next render target of a buffered render target ring, so that
+   * materials sampling the previous frame never race with this upload.
+   * If no target is given, a double-buffered one will be created.
+   * Returns the frame index of the upload, see UCVBufferedRenderTarget::IsFrameComplete.
+   */
+  UFUNCTION(BlueprintCallable, meta = (DisplayName = "Copy CVUMat to Buffered Render Target"),
+            Category = "OpenCV|Core")
+  int32 ToBufferedRenderTarget(UPARAM(ref) UCVBufferedRenderTarget*& target, bool resize);
+
+  /**
+   * Upload only the given regions (in pixels) of the UCVMat to the render target.
+   * The render target has to match the matrix dimensions; otherwise it is reinitialized and
+   * updated as a whole.
+   */
+  UFUNCTION(BlueprintCallable, meta = (DisplayName = "Copy CVUMat Regions to Render Target"),
+            Category = "OpenCV|Core")
+  void ToRenderTargetRegions(UPARAM(ref) UTextureRenderTarget2D*& renderTarget,
+                             const TArray<FIntRect>& regions);
+
+  /**
+   * Upload only the given regions (in pixels) of the UCVMat to the texture.
+   * The texture has to match the matrix dimensions; a newly created texture is updated as a whole.
+   */
+  UFUNCTION(BlueprintCallable, meta = (DisplayName = "Copy CVUMat Regions to Texture2D"),
+            Category = "OpenCV|Core")
+  void ToTextureRegions(UPARAM(ref) UTexture2D*& texture, const TArray<FIntRect>& regions);
+
+  /**
+   * Upload the 3D UCVMat to a volume texture, keeping the voxel values.
+   * 8U, 16U and 32F volumes are copied as-is to PF_G8, PF_G16 and PF_R32_FLOAT textures. 16S
+   * volumes hold integers (e.g. CT in Hounsfield units, as loaded from MET_SHORT files) and are
+   * converted to half floats in a PF_R16F texture, values beyond +-2048 are rounded.
+   */
   UFUNCTION(BlueprintCallable, meta = (DisplayName = "Copy CVUMat to Texture3D"),
             Category = "OpenCV|Core")
   void ToVolumeTexture(UPARAM(ref) UVolumeTexture*& volumeTexture);
 
+  /**
+   * Upload the 3D UCVMat to an 8-bit volume texture, mapping the window
+   * [windowCenter - windowWidth / 2, windowCenter + windowWidth / 2] to [0, 255].
+   * The quantisation is done in parallel while writing the texture memory. As in ToVolumeTexture,
+   * 16S volumes are interpreted as integers (e.g. CT in Hounsfield units).
+   */
+  UFUNCTION(BlueprintCallable, meta = (DisplayName = "Copy CVUMat to Texture3D (Window/Level)"),
+            Category = "OpenCV|Core")
+  void ToVolumeTextureWindowed(UPARAM(ref) UVolumeTexture*& volumeTexture, float windowCenter,
+                               float windowWidth);
+
+  /**
+   * Update only the slices [zBegin, zEnd) of an existing volume texture with the corresponding
+   * slices of the UCVMat. The RHI texture is kept and only the changed slab is uploaded, which
+   * is much cheaper than ToVolumeTexture for slice-by-slice streaming.
+   * Only mip 0 is updated. If the texture does not match the volume (or does not exist yet), the
+   * whole volume is uploaded through ToVolumeTexture instead.
+   */
+  UFUNCTION(BlueprintCallable, meta = (DisplayName = "Copy CVUMat Slices to Texture3D"),
+            Category = "OpenCV|Core")
+  void ToVolumeTextureSlices(UPARAM(ref) UVolumeTexture*& volumeTexture, int32 zBegin,
+                             int32 zEnd);
+
+  /**
+   * Read the texture back into a UCVUMat. This waits for the render thread; use the async
+   * variant (UCVAsyncReadTexture / FCVTextureReadback) for per-frame readbacks.
+   */
   UFUNCTION(BlueprintCallable, meta = (DisplayName = "Create CVUMat from Texture2D"),
             Category = "OpenCV|Core")
   static void FromTexture2D(UTexture2D* texture, UPARAM(ref) UCVUMat*& mat);
 
+  /**
+   * Read the CPU copy of mip 0 of the volume texture into a UCVUMat. PF_R16F textures are
+   * returned as 32F volumes, other formats as their OpenCV equivalent.
+   * Volumes without a CPU copy can be read back from the GPU with UCVAsyncReadTexture, which needs
+   * SM5 and supports PF_G8, PF_G16, PF_R16F, PF_R32_FLOAT, PF_FloatRGBA and PF_A32B32G32R32F only
+   * (no compressed, BGRA8 or other formats).
+   */
   UFUNCTION(BlueprintCallable, meta = (DisplayName = "Create CVUMat from Texture3D"),
             Category = "OpenCV|Core")
   static void FromVolumeTexture(UVolumeTexture* texture, UPARAM(ref) UCVUMat*& mat);
 
+  /**
+   * Get the hit/miss counters of the staging memory pool used by ToTexture/ToRenderTarget.
+   * In steady state (constant frame size), Misses should stop increasing.
+   */
+  UFUNCTION(BlueprintPure, meta = (DisplayName = "Get Upload Staging Pool Stats"),
+            Category = "OpenCV|Core")
+  static FCVStagingPoolStats GetStagingPoolStats();
+
+  /**
+   * Set the high-water mark of the upload staging memory pool. Memory returned to the pool above
+   * this limit is freed immediately. Pass 0 to disable pooling.
+   */
+  UFUNCTION(BlueprintCallable, meta = (DisplayName = "Set Upload Staging Pool Limit"),
+            Category = "OpenCV|Core")
+  static void SetStagingPoolLimit(int32 MaxPooledMegaBytes);
+
 private:
+  void UploadToRenderTarget(UTextureRenderTarget2D*& renderTarget, bool resize,
+                            const TArray<FIntRect>* regions);
+  void UploadToTexture(UTexture2D*& texture, bool resize, const TArray<FIntRect>* regions);
+
+  // Diffs the matrix against the previous upload to Target. Returns nullptr if the whole texture
+  // needs to be updated, otherwise OutTiles with the changed tiles.
+  const TArray<FIntRect>* GetChangedTiles(UTexture* Target, bool bTargetReset,
+                                          TArray<FIntRect>& OutTiles);
+
+  // CPU copy of the last upload and its target, used by bUploadChangedTilesOnly. The target is
+  // only set once the upload was enqueued, together with the serial number it got.
+  cv::Mat PreviousUpload;
+  TWeakObjectPtr<UTexture> PreviousUploadTarget;
+  uint64 PreviousUploadSerial = 0;
+
   //// Use this function to update the texture rects you want to change:
   //// NOTE: This is very similar to a in UTexture2D::UpdateTextureRegions but it is compiled
   //// WITH_EDITOR and is not marked as ENGINE_API so it cannot be linked from plugins.
@@ -40,7 +40,8 @@ public class OpenCV : ModuleRules
                 "Projects",
                 "InputCore",
                 "RHI",
-                "RenderCore"
+                "RenderCore",
+                "ShaderCore"
             });
 		
 		
@@ -0,0 +1,65 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#include "CVAsyncReadTexture.h"
+
+#include "CVTextureReadback.h"
+#include "OpenCV_Common.h"
+
+#include "Engine/Texture.h"
+#include "Engine/VolumeTexture.h"
+
+UCVAsyncReadTexture* UCVAsyncReadTexture::ReadTextureAsync(UObject* WorldContextObject,
+                                                           UTexture* Texture, UCVUMat* Mat) {
+  auto* Action = NewObject<UCVAsyncReadTexture>();
+  Action->Texture = Texture;
+  Action->Mat = Mat ? Mat : NewObject<UCVUMat>();
+  Action->RegisterWithGameInstance(WorldContextObject);
+  return Action;
+}
+
+UCVAsyncReadTexture* UCVAsyncReadTexture::ReadVolumeTextureAsync(UObject* WorldContextObject,
+                                                                 UVolumeTexture* Texture,
+                                                                 UCVUMat* Mat) {
+  return ReadTextureAsync(WorldContextObject, Texture, Mat);
+}
+
+void UCVAsyncReadTexture::Activate() {
+  TWeakObjectPtr<UCVAsyncReadTexture> WeakThis(this);
+  auto OnComplete = [WeakThis](bool bSuccess, cv::UMat Result) {
+    if (WeakThis.IsValid()) {
+      WeakThis->OnReadbackComplete(bSuccess, MoveTemp(Result));
+    }
+  };
+
+  bool bEnqueued = false;
+  if (auto* VolumeTexture = Cast<UVolumeTexture>(Texture)) {
+    // Volumes that still have their CPU copy do not need to go through the GPU
+    const bool bHasCPUBacking = VolumeTexture->PlatformData &&
+                                VolumeTexture->PlatformData->Mips.Num() > 0 &&
+                                VolumeTexture->PlatformData->Mips[0].BulkData.IsBulkDataLoaded() &&
+                                VolumeTexture->PlatformData->Mips[0].BulkData.GetBulkDataSize() > 0;
+    if (bHasCPUBacking) {
+      UCVUMat::FromVolumeTexture(VolumeTexture, Mat);
+      OnReadbackComplete(!Mat->m.empty(), Mat->m);
+      return;
+    }
+    bEnqueued = FCVTextureReadback::Get().EnqueueVolume(VolumeTexture, OnComplete);
+  } else {
+    bEnqueued = FCVTextureReadback::Get().Enqueue(Texture, OnComplete);
+  }
+
+  if (!bEnqueued) {
+    OnReadbackComplete(false, cv::UMat());
+  }
+}
+
+void UCVAsyncReadTexture::OnReadbackComplete(bool bSuccess, cv::UMat Result) {
+  if (bSuccess) {
+    Mat->m = Result;
+    OnCompleted.Broadcast(Mat);
+  } else {
+    OnFailed.Broadcast(Mat);
+  }
+  SetReadyToDestroy();
+}
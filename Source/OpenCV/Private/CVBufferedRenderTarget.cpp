@@ -0,0 +1,84 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#include "CVBufferedRenderTarget.h"
+
+#include "CVTextureFormats.h"
+#include "OpenCV_Common.h"
+#include "UCVUMat.h"
+
+#include "Engine/TextureRenderTarget2D.h"
+#include "RenderingThread.h"
+
+UCVBufferedRenderTarget::UCVBufferedRenderTarget()
+    : LastFrame(0)
+    , NextBuffer(0)
+    , CompletedFrame(MakeShared<FThreadSafeCounter, ESPMode::ThreadSafe>()) {}
+
+UCVBufferedRenderTarget* UCVBufferedRenderTarget::Create(int32 NumBuffers) {
+  auto* Target = NewObject<UCVBufferedRenderTarget>();
+  Target->RenderTargets.SetNumZeroed(FMath::Max(NumBuffers, 2));
+  Target->BufferFrames.SetNumZeroed(Target->RenderTargets.Num());
+  return Target;
+}
+
+int32 UCVBufferedRenderTarget::GetLatestCompletedBuffer() const {
+  const int32 Completed = GetLatestCompletedFrame();
+  int32 Latest = INDEX_NONE;
+  for (int32 i = 0; i < BufferFrames.Num(); ++i) {
+    if (BufferFrames[i] > 0 && BufferFrames[i] <= Completed &&
+        (Latest == INDEX_NONE || BufferFrames[i] > BufferFrames[Latest])) {
+      Latest = i;
+    }
+  }
+  return Latest;
+}
+
+UTextureRenderTarget2D* UCVBufferedRenderTarget::GetLatestCompleted() const {
+  const int32 Buffer = GetLatestCompletedBuffer();
+  return Buffer != INDEX_NONE ? RenderTargets[Buffer] : nullptr;
+}
+
+int32 UCVBufferedRenderTarget::Upload(UCVUMat* Mat, bool Resize) {
+  if (!Mat || Mat->m.empty()) {
+    UE_LOG(OpenCV, Error, TEXT("Cannot upload an empty matrix!"));
+    return 0;
+  }
+
+  // ToRenderTarget does not report failures, so a matrix it would skip must not publish the
+  // previous contents of the buffer as a new frame
+  detail::FCVUploadFormat Format;
+  if (!detail::NegotiateUploadFormat(Mat->m.type(), Format)) {
+    UE_LOG(OpenCV, Error, TEXT("It seems that the OpenCV type is not supported!"));
+    return 0;
+  }
+
+  if (RenderTargets.Num() < 2) {
+    RenderTargets.SetNumZeroed(2);
+  }
+  BufferFrames.SetNumZeroed(RenderTargets.Num());
+
+  // Never write into the render target that is currently published
+  NextBuffer %= RenderTargets.Num();
+  if (NextBuffer == GetLatestCompletedBuffer()) {
+    NextBuffer = (NextBuffer + 1) % RenderTargets.Num();
+  }
+
+  const int32 Buffer = NextBuffer;
+  NextBuffer = (NextBuffer + 1) % RenderTargets.Num();
+
+  UTextureRenderTarget2D*& RenderTarget = RenderTargets[Buffer];
+  Mat->ToRenderTarget(RenderTarget, Resize);
+  if (!RenderTarget) return 0;
+
+  const int32 Frame = ++LastFrame;
+  BufferFrames[Buffer] = Frame;
+
+  // Render commands execute in order, so this runs after the texture update was submitted
+  using FCounterRef = TSharedRef<FThreadSafeCounter, ESPMode::ThreadSafe>;
+  ENQUEUE_UNIQUE_RENDER_COMMAND_TWOPARAMETER(PublishCVBufferedRenderTarget, FCounterRef, Counter,
+                                             CompletedFrame, int32, Frame, Frame,
+                                             { Counter->Set(Frame); });
+
+  return Frame;
+}
@@ -0,0 +1,199 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#include "CVCaptureManager.h"
+
+#include "CVCaptureWorker.h"
+#include "OpenCV_Common.h"
+
+#include "HAL/PlatformTime.h"
+#include "Misc/IQueuedWork.h"
+#include "Misc/QueuedThreadPool.h"
+
+// A stream of the manager, read one frame per task on the shared thread pool
+struct FCVManagedStream : public IQueuedWork {
+  FCVManagedStream(const FCVCaptureSettings& Settings, FQueuedThreadPool& InPool)
+      : Worker(Settings), Pool(InPool), bOpened(false) {}
+
+  //~ Begin IQueuedWork Interface
+  virtual void DoThreadedWork() override {
+    if (!bOpened) {
+      bOpened = true;
+      if (!Worker.Open()) return;
+    }
+    // Put the stream back at the end of the queue, so a pool with fewer threads than streams
+    // reads all of them in turns. During shutdown the pool abandons the work instead.
+    if (Worker.ReadFrame()) {
+      Pool.AddQueuedWork(this);
+    }
+  }
+  virtual void Abandon() override {}
+  //~ End IQueuedWork Interface
+
+  FCVCaptureWorker Worker;
+  FQueuedThreadPool& Pool;
+  bool bOpened;
+
+  // Frames taken from the worker that have not been matched yet, oldest first (game thread only)
+  TArray<FCVCaptureFrame> Pending;
+};
+
+ACVCaptureManager::ACVCaptureManager() {
+  PrimaryActorTick.bCanEverTick = true;
+
+  NumWorkerThreads = 0;
+  SyncTolerance = 0.01f;
+  RefreshRate = 30;
+  ShouldResize = false;
+  ResizeDimensions = FVector2D(320, 240);
+  FrameQueueCapacity = 4;
+  MatchedSets = 0;
+  UnmatchedFrames = 0;
+  OpenStreams = 0;
+  ThreadPool = nullptr;
+  StartTime = 0.0;
+}
+
+void ACVCaptureManager::BeginPlay() {
+  Super::BeginPlay();
+
+  if (Streams.Num() == 0) return;
+
+  const int32 NumThreads = NumWorkerThreads > 0 ? NumWorkerThreads : Streams.Num();
+  ThreadPool = FQueuedThreadPool::Allocate();
+  if (!ThreadPool->Create(NumThreads, 0, TPri_Normal)) {
+    UE_LOG(OpenCV, Error, TEXT("Could not create the capture thread pool!"));
+    delete ThreadPool;
+    ThreadPool = nullptr;
+    return;
+  }
+
+  StartTime = FPlatformTime::Seconds();
+  MatchedSets = 0;
+  UnmatchedFrames = 0;
+
+  FrameSet.Frames.Reset();
+  FrameSet.CaptureTimes.Init(0.f, Streams.Num());
+  StreamFrames.Reset();
+
+  for (const FCVCaptureStreamConfig& Stream : Streams) {
+    FCVCaptureSettings Settings;
+    Settings.CameraID = Stream.CameraID;
+    Settings.VideoFile = Stream.VideoFile;
+    Settings.bResize = ShouldResize;
+    Settings.ResizeTo = cv::Size(ResizeDimensions.X, ResizeDimensions.Y);
+    Settings.FrameRate = RefreshRate;
+    // Keep a few frames per stream, so there is something to choose from when matching
+    Settings.QueuePolicy = ECVFrameQueuePolicy::FifoDropOldest;
+    Settings.QueueCapacity = FrameQueueCapacity;
+
+    ManagedStreams.Add(new FCVManagedStream(Settings, *ThreadPool));
+    StreamFrames.Add(NewObject<UCVUMat>(this));
+    FrameSet.Frames.Add(StreamFrames.Last());
+  }
+
+  for (FCVManagedStream* Stream : ManagedStreams) {
+    ThreadPool->AddQueuedWork(Stream);
+  }
+}
+
+void ACVCaptureManager::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+  Super::EndPlay(EndPlayReason);
+
+  // Interrupt waiting workers, then let the pool finish the running tasks and abandon the rest
+  for (FCVManagedStream* Stream : ManagedStreams) {
+    Stream->Worker.Stop();
+  }
+  if (ThreadPool) {
+    ThreadPool->Destroy();
+    delete ThreadPool;
+    ThreadPool = nullptr;
+  }
+
+  for (FCVManagedStream* Stream : ManagedStreams) {
+    delete Stream;
+  }
+  ManagedStreams.Reset();
+  OpenStreams = 0;
+}
+
+void ACVCaptureManager::Tick(float DeltaTime) {
+  Super::Tick(DeltaTime);
+
+  OpenStreams = 0;
+  for (FCVManagedStream* Stream : ManagedStreams) {
+    if (Stream->Worker.IsOpen()) ++OpenStreams;
+
+    FCVCaptureFrame Frame;
+    while (Stream->Worker.PopFrame(Frame)) {
+      // A stream that runs far ahead of the others cannot be matched anyway
+      if (Stream->Pending.Num() >= FrameQueueCapacity) {
+        Stream->Pending.RemoveAt(0);
+        ++UnmatchedFrames;
+      }
+      Stream->Pending.Add(MoveTemp(Frame));
+    }
+  }
+
+  if (MatchFrameSets()) {
+    OnFrameSetUpdated();
+    On_FrameSetUpdated.Broadcast(FrameSet);
+  }
+}
+
+bool ACVCaptureManager::MatchFrameSets() {
+  if (ManagedStreams.Num() == 0) return false;
+
+  const int32 NumStreams = ManagedStreams.Num();
+  bool bMatched = false;
+
+  for (;;) {
+    for (FCVManagedStream* Stream : ManagedStreams) {
+      if (Stream->Pending.Num() == 0) return bMatched;
+    }
+
+    // No set can contain a frame older than the oldest pending frame of any stream, so the latest
+    // of those is the reference the other streams are matched against
+    double Reference = ManagedStreams[0]->Pending[0].Timestamps.Grab;
+    for (FCVManagedStream* Stream : ManagedStreams) {
+      Reference = FMath::Max(Reference, Stream->Pending[0].Timestamps.Grab);
+    }
+
+    // Skip frames for which a later frame of the same stream is at least as close. The reference
+    // never decreases, so they would never be the closest again.
+    int32 Oldest = 0;
+    double MinTime = TNumericLimits<double>::Max();
+    double MaxTime = TNumericLimits<double>::Lowest();
+    for (int32 i = 0; i < NumStreams; ++i) {
+      TArray<FCVCaptureFrame>& Pending = ManagedStreams[i]->Pending;
+      while (Pending.Num() > 1 && FMath::Abs(Pending[1].Timestamps.Grab - Reference) <=
+                                      FMath::Abs(Pending[0].Timestamps.Grab - Reference)) {
+        Pending.RemoveAt(0);
+        ++UnmatchedFrames;
+      }
+      if (Pending[0].Timestamps.Grab < MinTime) {
+        MinTime = Pending[0].Timestamps.Grab;
+        Oldest = i;
+      }
+      MaxTime = FMath::Max(MaxTime, Pending[0].Timestamps.Grab);
+    }
+
+    if (MaxTime - MinTime > SyncTolerance) {
+      // The oldest frame is too far from the reference, and all later frames are even farther
+      ManagedStreams[Oldest]->Pending.RemoveAt(0);
+      ++UnmatchedFrames;
+      continue;
+    }
+
+    // Only the most recent set is delivered, earlier ones of the same tick are overwritten
+    for (int32 i = 0; i < NumStreams; ++i) {
+      FCVCaptureFrame& Frame = ManagedStreams[i]->Pending[0];
+      StreamFrames[i]->m = Frame.Image;
+      FrameSet.CaptureTimes[i] = static_cast<float>(Frame.Timestamps.Grab - StartTime);
+      ManagedStreams[i]->Pending.RemoveAt(0);
+    }
+    FrameSet.Spread = static_cast<float>(MaxTime - MinTime);
+    ++MatchedSets;
+    bMatched = true;
+  }
+}
@@ -0,0 +1,571 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#include "CVCaptureWorker.h"
+
+#include "OpenCV_Common.h"
+
+#include "Async/Async.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/IQueuedWork.h"
+#include "Misc/QueuedThreadPool.h"
+#include "Misc/ScopeLock.h"
+
+THIRD_PARTY_INCLUDES_START
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+THIRD_PARTY_INCLUDES_END
+
+DECLARE_CYCLE_STAT(TEXT("Capture Grab"), STAT_OpenCV_CaptureGrab, STATGROUP_OpenCV);
+DECLARE_CYCLE_STAT(TEXT("Capture Retrieve"), STAT_OpenCV_CaptureRetrieve, STATGROUP_OpenCV);
+DECLARE_CYCLE_STAT(TEXT("Capture Decode MJPG"), STAT_OpenCV_CaptureDecode, STATGROUP_OpenCV);
+DECLARE_CYCLE_STAT(TEXT("Capture Resize"), STAT_OpenCV_CaptureResize, STATGROUP_OpenCV);
+DECLARE_CYCLE_STAT(TEXT("Capture Processing"), STAT_OpenCV_CaptureProcess, STATGROUP_OpenCV);
+DECLARE_CYCLE_STAT(TEXT("Capture Seek"), STAT_OpenCV_CaptureSeek, STATGROUP_OpenCV);
+
+struct FCVCaptureWorker::FDecodeJob : public IQueuedWork {
+  //~ Begin IQueuedWork Interface
+  virtual void DoThreadedWork() override {
+    try {
+      {
+        SCOPE_CYCLE_COUNTER(STAT_OpenCV_CaptureDecode);
+        // Backends that ignore CAP_PROP_CONVERT_RGB deliver decoded frames, pass those through
+        if (Encoded.rows == 1 && Encoded.type() == CV_8UC1) {
+          cv::imdecode(Encoded, cv::IMREAD_COLOR, &Decoded);
+        } else {
+          cv::swap(Encoded, Decoded);
+        }
+      }
+      Timestamps.Retrieve = FPlatformTime::Seconds();
+      if (bResize && !Decoded.empty()) {
+        SCOPE_CYCLE_COUNTER(STAT_OpenCV_CaptureResize);
+        cv::resize(Decoded, Resized, ResizeTo);
+      }
+      Timestamps.Resize = FPlatformTime::Seconds();
+    } catch (cv::Exception& e) {
+      UE_LOG(OpenCV, Warning, TEXT("Function %s: Caught OpenCV Exception: %s"),
+             TEXT(__FUNCTION__), UTF8_TO_TCHAR(e.what()));
+      Decoded.release();
+    }
+    bDone = true;
+  }
+  virtual void Abandon() override {
+    Decoded.release();
+    bDone = true;
+  }
+  //~ End IQueuedWork Interface
+
+  // The image as published, after decoding and resizing. Empty if decoding failed; Resized keeps
+  // its buffer (and the previous frame) between uses of the job, so it only counts with Decoded.
+  cv::Mat GetResult() const { return Decoded.empty() ? cv::Mat() : bResize ? Resized : Decoded; }
+
+  cv::Mat Encoded;
+  cv::Mat Decoded;
+  cv::Mat Resized;
+  bool bResize = false;
+  cv::Size ResizeTo;
+
+  int64 FrameNumber = 0;
+  double StreamTime = 0.0;
+  FCVFrameTimestamps Timestamps;
+  FThreadSafeBool bDone;
+};
+
+FCVCaptureWorker::FCVCaptureWorker(const FCVCaptureSettings& InSettings)
+    : Settings(InSettings),
+      Processing(InSettings.ProcessingChain),
+      FrameCache(InSettings.bScrubbing ? InSettings.FrameCacheSize : 0),
+      Queue(InSettings.QueueCapacity, InSettings.QueuePolicy),
+      NextPublish(0),
+      NextSubmit(0),
+      FrameInterval(0.0),
+      NextFrameTime(0.0),
+      FrameNumber(0),
+      bPaceByTimestamps(false),
+      FrameDuration(0.0),
+      PlaybackStart(-1.0),
+      StreamTime(-1.0),
+      SeekFrame(-1),
+      SeekTime(-1.0),
+      ResumeFrame(-1),
+      LastPopTime(0.0),
+      PopInterval(0.0),
+      Thread(nullptr) {}
+
+FCVCaptureWorker::~FCVCaptureWorker() {
+  if (Thread) {
+    Thread->Kill(true);
+    delete Thread;
+  }
+  // The decode jobs must not be freed while the thread pool still works on them
+  bStopRequested = true;
+  FlushDecodes();
+
+  // Building the index checks bStopRequested after every frame
+  if (IndexBuild.IsValid()) {
+    IndexBuild.Wait();
+  }
+}
+
+void FCVCaptureWorker::Start() {
+  check(!Thread);
+  Thread = FRunnableThread::Create(this, TEXT("OpenCV Capture"), 0, TPri_Normal);
+}
+
+namespace {
+// True if another UMat header (e.g. a consumer of an earlier frame) still references the buffer
+bool IsShared(const cv::UMat& Image) { return Image.u && Image.u->urefcount > 1; }
+}  // namespace
+
+bool FCVCaptureWorker::WaitUntil(double Time) const {
+  for (double Now = FPlatformTime::Seconds(); Now < Time; Now = FPlatformTime::Seconds()) {
+    if (bStopRequested) return false;
+    // Sleep in short steps to react to Stop() quickly
+    FPlatformProcess::Sleep(static_cast<float>(FMath::Min(Time - Now, 0.01)));
+  }
+  return !bStopRequested;
+}
+
+bool FCVCaptureWorker::IsSupersededBeforePop(double Due) const {
+  const double Interval = PopInterval.load();
+  if (Queue.Num() == 0 || Interval <= 0 || FrameDuration <= 0 ||
+      Queue.GetPolicy() == ECVFrameQueuePolicy::FifoBackpressure) {
+    return false;
+  }
+
+  // Number of newer frames that are due before the consumer is expected back
+  const double ExpectedPop = FMath::Max(LastPopTime.load() + Interval, FPlatformTime::Seconds());
+  const int32 NewerFrames = FMath::FloorToInt((ExpectedPop - Due) / FrameDuration);
+
+  // LatestOnly skips to the newest frame, FifoDropOldest drops this one once enough newer frames
+  // were queued behind it
+  return Queue.GetPolicy() == ECVFrameQueuePolicy::LatestOnly
+             ? NewerFrames >= 1
+             : NewerFrames >= Queue.GetCapacity();
+}
+
+bool FCVCaptureWorker::PopFrame(FCVCaptureFrame& OutFrame) {
+  if (!Queue.Pop(OutFrame)) return false;
+
+  // The capture thread predicts the next pop from these, see IsSupersededBeforePop
+  const double Now = FPlatformTime::Seconds();
+  const double Last = LastPopTime.load();
+  if (Last > 0) {
+    const double Interval = PopInterval.load();
+    PopInterval.store(Interval > 0 ? 0.9 * Interval + 0.1 * (Now - Last) : Now - Last);
+  }
+  LastPopTime.store(Now);
+  return true;
+}
+
+bool FCVCaptureWorker::Open() {
+  // Opening a device can take a while, so this happens on the capture thread as well
+  try {
+    if (Settings.CameraID >= 0) {
+      Capture.open(Settings.CameraID);
+    } else {
+      Capture.open(std::string(TCHAR_TO_UTF8(*Settings.VideoFile)));
+    }
+  } catch (cv::Exception& e) {
+    UE_LOG(OpenCV, Warning, TEXT("Function %s: Caught OpenCV Exception: %s"), TEXT(__FUNCTION__),
+           UTF8_TO_TCHAR(e.what()));
+  }
+
+  if (!Capture.isOpened()) {
+    UE_LOG(OpenCV, Warning, TEXT("Could not open Stream %s "), *Settings.VideoFile);
+    return false;
+  }
+
+  FrameInterval = Settings.FrameRate > 0 ? 1.0 / Settings.FrameRate : 0.0;
+  NextFrameTime = FPlatformTime::Seconds();
+  FrameNumber = 0;
+
+  // Timestamp pacing: the file's frame duration and the wall clock time of stream time 0
+  bPaceByTimestamps = Settings.bPaceByTimestamps && Settings.CameraID < 0;
+  const double FileFPS = Capture.get(cv::CAP_PROP_FPS);
+  // Some backends do not report a frame rate, the refresh rate stands in for it then
+  FrameDuration = FileFPS > 0 ? 1.0 / FileFPS : FrameInterval;
+  PlaybackStart = -1.0;
+  StreamTime = -1.0;
+
+  if (Settings.bParallelMJPEG && Settings.CameraID >= 0) {
+    // Ask for MJPG and the undecoded buffers, the decode jobs deal with backends that refuse
+    Capture.set(cv::CAP_PROP_FOURCC, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'));
+    Capture.set(cv::CAP_PROP_CONVERT_RGB, 0);
+
+    DecodeJobs.SetNum(FMath::Max(Settings.MaxDecodesInFlight, 1));
+    for (TUniquePtr<FDecodeJob>& Job : DecodeJobs) {
+      Job = MakeUnique<FDecodeJob>();
+      Job->bResize = Settings.bResize;
+      Job->ResizeTo = Settings.ResizeTo;
+    }
+    NextPublish = NextSubmit = 0;
+  }
+
+  if (Settings.bScrubbing && Settings.CameraID < 0) {
+    if (detail::LoadVideoIndex(Settings.VideoFile, Index)) {
+      bIndexReady = true;
+    } else {
+      // Reading through a long recording takes a while, playback and seeking by frame work
+      // without the index in the meantime
+      IndexBuild = Async<void>(EAsyncExecution::Thread, [this]() {
+        detail::FCVVideoIndex Built;
+        if (detail::BuildVideoIndex(Settings.VideoFile, bStopRequested, Built)) {
+          detail::SaveVideoIndex(Settings.VideoFile, Built);
+          Index = MoveTemp(Built);
+          bIndexReady = true;
+        }
+      });
+    }
+  }
+
+  bIsOpen = true;
+  return true;
+}
+
+bool FCVCaptureWorker::ReadFrame() {
+  if (ReadNextFrame()) return true;
+  FlushDecodes();
+  bIsOpen = false;
+  return false;
+}
+
+FCVCaptureFrame* FCVCaptureWorker::AcquireSlot() {
+  FCVCaptureFrame* Slot = Queue.BeginWrite();
+  while (!Slot && !bStopRequested) {
+    // The queue is full and the consumer wants every frame, so wait for it
+    FPlatformProcess::Sleep(0.001f);
+    Slot = Queue.BeginWrite();
+  }
+
+  // Reuse the slot buffer unless a consumer still holds on to the frame that was in it
+  if (Slot && IsShared(Slot->Image)) {
+    Slot->Image.release();
+  }
+  return Slot;
+}
+
+bool FCVCaptureWorker::ProcessFrame(const cv::UMat& Src, cv::UMat& Dst,
+                                    FCVFrameTimestamps& Timestamps) {
+  const cv::UMat* Input = &Src;
+  if (Settings.bResize) {
+    SCOPE_CYCLE_COUNTER(STAT_OpenCV_CaptureResize);
+    cv::UMat& Resized = Processing.IsEmpty() ? Dst : ResizedFrame;
+    cv::resize(Src, Resized, Settings.ResizeTo);
+    Input = &Resized;
+  }
+  Timestamps.Resize = FPlatformTime::Seconds();
+
+  if (!Processing.IsEmpty()) {
+    SCOPE_CYCLE_COUNTER(STAT_OpenCV_CaptureProcess);
+    if (!Processing.Apply(*Input, Dst)) return false;
+  }
+  Timestamps.Process = FPlatformTime::Seconds();
+  return true;
+}
+
+bool FCVCaptureWorker::SubmitDecode(const FCVFrameTimestamps& Timestamps) {
+  FDecodeJob& Job = *DecodeJobs[NextSubmit % DecodeJobs.Num()];
+  check(Job.bDone || NextSubmit < DecodeJobs.Num());
+
+  // retrieve() copies the driver buffer, so the job owns its compressed frame
+  if (!Capture.retrieve(Job.Encoded) || Job.Encoded.empty()) {
+    return false;
+  }
+  Job.FrameNumber = FrameNumber;
+  Job.StreamTime = StreamTime;
+  Job.Timestamps = Timestamps;
+  Job.bDone = false;
+  ++NextSubmit;
+
+  GThreadPool->AddQueuedWork(&Job);
+  return true;
+}
+
+bool FCVCaptureWorker::PublishDecoded(bool bWait, int32 MaxInFlight) {
+  while (NextPublish < NextSubmit) {
+    FDecodeJob& Job = *DecodeJobs[NextPublish % DecodeJobs.Num()];
+    if (!Job.bDone) {
+      if (!bWait || NextSubmit - NextPublish <= MaxInFlight) break;
+      // Decodes take milliseconds, so polling does not add noticeable latency
+      FPlatformProcess::Sleep(0.0002f);
+      continue;
+    }
+
+    // Frames are published in sequence order, even if a later one finished decoding first
+    ++NextPublish;
+    const cv::Mat Image = Job.GetResult();
+    if (Image.empty() || bStopRequested) continue;
+
+    FCVCaptureFrame* Slot = AcquireSlot();
+    if (!Slot) return false;
+    if (Processing.IsEmpty()) {
+      Image.copyTo(Slot->Image);
+    } else {
+      SCOPE_CYCLE_COUNTER(STAT_OpenCV_CaptureProcess);
+      // Drop the frame if processing failed, the slot is reused for the next one
+      if (!Processing.Apply(Image.getUMat(cv::ACCESS_READ), Slot->Image)) continue;
+    }
+    Slot->FrameNumber = Job.FrameNumber;
+    Slot->StreamTime = Job.StreamTime;
+    Slot->Timestamps = Job.Timestamps;
+    Slot->Timestamps.Process = FPlatformTime::Seconds();
+    Slot->Timestamps.Publish = Slot->Timestamps.Process;
+    Queue.EndWrite();
+  }
+  return true;
+}
+
+void FCVCaptureWorker::FlushDecodes() {
+  // Stopping skips publishing, but every job in flight has to finish before it is reused
+  try {
+    PublishDecoded(true, 0);
+  } catch (cv::Exception& e) {
+    UE_LOG(OpenCV, Warning, TEXT("Function %s: Caught OpenCV Exception: %s"), TEXT(__FUNCTION__),
+           UTF8_TO_TCHAR(e.what()));
+  }
+  for (; NextPublish < NextSubmit; ++NextPublish) {
+    FDecodeJob& Job = *DecodeJobs[NextPublish % DecodeJobs.Num()];
+    while (!Job.bDone) {
+      FPlatformProcess::Sleep(0.0002f);
+    }
+  }
+}
+
+bool FCVCaptureWorker::RetrieveAndPublish(FCVFrameTimestamps& Timestamps, cv::UMat* OutImage) {
+  FCVCaptureFrame* Slot = AcquireSlot();
+  if (!Slot) return false;
+
+  const bool bProcess = Settings.bResize || !Processing.IsEmpty();
+  cv::UMat& Target = bProcess ? RawFrame : Slot->Image;
+  {
+    SCOPE_CYCLE_COUNTER(STAT_OpenCV_CaptureRetrieve);
+    if (!Capture.retrieve(Target) || Target.empty()) {
+      return false;
+    }
+  }
+  Timestamps.Retrieve = FPlatformTime::Seconds();
+  if (bProcess) {
+    // Drop just this frame if processing failed, the slot is reused for the next one
+    if (!ProcessFrame(RawFrame, Slot->Image, Timestamps)) return true;
+  } else {
+    Timestamps.Resize = Timestamps.Process = Timestamps.Retrieve;
+  }
+
+  if (OutImage) {
+    *OutImage = Slot->Image;
+  }
+  Slot->FrameNumber = FrameNumber;
+  Slot->StreamTime = StreamTime;
+  Slot->Timestamps = Timestamps;
+  Slot->Timestamps.Publish = FPlatformTime::Seconds();
+  Queue.EndWrite();
+  return true;
+}
+
+void FCVCaptureWorker::SeekToFrame(int64 Frame) {
+  if (Settings.CameraID >= 0) {
+    UE_LOG(OpenCV, Warning, TEXT("Camera %d cannot seek, ignoring seek to frame %lld"),
+           Settings.CameraID, Frame);
+    return;
+  }
+  FScopeLock Lock(&SeekLock);
+  SeekFrame = FMath::Max<int64>(Frame, 0);
+  SeekTime = -1.0;
+}
+
+void FCVCaptureWorker::SeekToTime(double Time) {
+  if (Settings.CameraID >= 0) {
+    UE_LOG(OpenCV, Warning, TEXT("Camera %d cannot seek, ignoring seek to %.3f s"),
+           Settings.CameraID, Time);
+    return;
+  }
+  FScopeLock Lock(&SeekLock);
+  SeekFrame = -1;
+  SeekTime = FMath::Max(Time, 0.0);
+}
+
+bool FCVCaptureWorker::MoveCaptureTo(int64 Target) {
+  int64 MaxForward = Settings.MaxForwardGrab;
+  if (MaxForward <= 0) {
+    MaxForward = FrameDuration > 0 ? static_cast<int64>(1.0 / FrameDuration + 0.5) : 30;
+  }
+
+  // A negative FrameNumber means the position of the capture is unknown
+  if (FrameNumber >= 0 && Target >= FrameNumber && Target - FrameNumber <= MaxForward) {
+    // A seek restarts decoding at the previous keyframe, close targets are cheaper to read up to
+    SCOPE_CYCLE_COUNTER(STAT_OpenCV_CaptureGrab);
+    for (; FrameNumber < Target; ++FrameNumber) {
+      if (!Capture.grab()) return false;
+    }
+  } else if (Target != FrameNumber) {
+    SCOPE_CYCLE_COUNTER(STAT_OpenCV_CaptureSeek);
+    if (!Capture.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(Target))) return false;
+    FrameNumber = Target;
+  }
+  return true;
+}
+
+bool FCVCaptureWorker::ServeSeek(bool& bOutServed) {
+  int64 Target;
+  double Time;
+  {
+    FScopeLock Lock(&SeekLock);
+    Target = SeekFrame;
+    Time = SeekTime;
+    SeekFrame = -1;
+    SeekTime = -1.0;
+  }
+  // Camera requests are rejected by SeekToFrame/SeekToTime, a camera frame is never dropped here
+  bOutServed = Settings.CameraID < 0 && (Target >= 0 || Time >= 0);
+  if (!bOutServed) return true;
+
+  if (Target < 0) {
+    // Without the index, the nominal frame rate is the best guess
+    Target = bIndexReady ? Index.FindFrame(Time)
+                         : (FrameDuration > 0 ? static_cast<int64>(Time / FrameDuration) : 0);
+  }
+  if (bIndexReady && Index.Num() > 0) {
+    Target = FMath::Clamp<int64>(Target, 0, Index.Num() - 1);
+  }
+
+  // Playback continues in real time from the new position
+  PlaybackStart = -1.0;
+  NextFrameTime = FPlatformTime::Seconds() + FrameInterval;
+
+  FCVFrameTimestamps Timestamps;
+  Timestamps.Grab = FPlatformTime::Seconds();
+
+  cv::UMat Cached;
+  if (FrameCache.Find(Target, Cached)) {
+    FCVCaptureFrame* Slot = AcquireSlot();
+    if (!Slot) return false;
+
+    // Timestamp pacing continues from the cached frame's time when playback resumes
+    StreamTime = bIndexReady ? Index.GetFrameTime(Target) : Target * FrameDuration;
+
+    Slot->Image = Cached;
+    Slot->FrameNumber = Target + 1;
+    Slot->StreamTime = StreamTime;
+    Slot->Timestamps = Timestamps;
+    Slot->Timestamps.Retrieve = Slot->Timestamps.Resize = Slot->Timestamps.Process =
+        Slot->Timestamps.Publish = FPlatformTime::Seconds();
+    Queue.EndWrite();
+
+    // The capture is moved lazily, scrubbing between cached frames never touches it
+    ResumeFrame = Target + 1;
+    return true;
+  }
+
+  ResumeFrame = -1;
+  bool bGrabbed = MoveCaptureTo(Target);
+  if (bGrabbed) {
+    SCOPE_CYCLE_COUNTER(STAT_OpenCV_CaptureGrab);
+    bGrabbed = Capture.grab();
+  }
+  if (!bGrabbed) {
+    // Seeking beyond the end should not end the stream, continue from the first frame instead
+    UE_LOG(OpenCV, Warning, TEXT("Could not seek to frame %lld of %s"), Target,
+           *Settings.VideoFile);
+    ResumeFrame = 0;
+    FrameNumber = -1;
+    return true;
+  }
+  ++FrameNumber;
+  StreamTime = bIndexReady ? Index.GetFrameTime(Target)
+                           : Capture.get(cv::CAP_PROP_POS_MSEC) / 1000.0;
+
+  cv::UMat Published;
+  if (!RetrieveAndPublish(Timestamps, &Published)) return false;
+  if (!Published.empty()) {
+    FrameCache.Add(Target, Published);
+  }
+  return true;
+}
+
+bool FCVCaptureWorker::ReadNextFrame() {
+  if (bStopRequested) return false;
+
+  try {
+    bool bSeeked = false;
+    if (!ServeSeek(bSeeked)) return false;
+    if (bSeeked) return true;
+
+    if (bPaused) {
+      FPlatformProcess::Sleep(0.005f);
+      return !bStopRequested;
+    }
+
+    if (ResumeFrame >= 0) {
+      if (!MoveCaptureTo(ResumeFrame)) return false;
+      ResumeFrame = -1;
+    }
+
+    if (!bPaceByTimestamps && FrameInterval > 0) {
+      if (!WaitUntil(NextFrameTime)) return false;
+      // Don't try to catch up after a stall
+      NextFrameTime = FMath::Max(NextFrameTime + FrameInterval, FPlatformTime::Seconds());
+    }
+
+    // Grab the next frame (for files this decodes it, for cameras it latches the image), while
+    // retrieve() only converts and copies it out. This is as close to the exposure as the
+    // capture time can be taken.
+    {
+      SCOPE_CYCLE_COUNTER(STAT_OpenCV_CaptureGrab);
+      if (!Capture.grab()) return false;
+    }
+    FCVFrameTimestamps Timestamps;
+    Timestamps.Grab = FPlatformTime::Seconds();
+    ++FrameNumber;
+
+    if (bPaceByTimestamps) {
+      // Fall back to the frame rate if the backend does not report increasing timestamps
+      const double PosMsec = Capture.get(cv::CAP_PROP_POS_MSEC);
+      StreamTime = PosMsec / 1000.0 > StreamTime || StreamTime < 0 ? PosMsec / 1000.0
+                                                                    : StreamTime + FrameDuration;
+
+      const double Now = FPlatformTime::Seconds();
+      if (PlaybackStart < 0) {
+        PlaybackStart = Now - StreamTime;
+      }
+
+      // If the next frame is due already, nobody would ever see this one. The same goes if the
+      // consumer lags behind and newer frames will replace this one before it is popped. It is
+      // decoded already, but skipping retrieve() saves the conversion, resize and processing.
+      if ((FrameDuration > 0 && PlaybackStart + StreamTime + FrameDuration <= Now) ||
+          IsSupersededBeforePop(PlaybackStart + StreamTime)) {
+        NumSkipped.Increment();
+        return true;
+      }
+      if (!WaitUntil(PlaybackStart + StreamTime)) return false;
+      // The frame is due now, waiting for that is not part of its latency
+      Timestamps.Grab = FPlatformTime::Seconds();
+    } else {
+      StreamTime = Capture.get(cv::CAP_PROP_POS_MSEC) / 1000.0;
+    }
+
+    if (DecodeJobs.Num() > 0) {
+      // Keep the decodes of several frames in flight, and only wait once all jobs are busy
+      if (!PublishDecoded(true, DecodeJobs.Num() - 1)) return false;
+      if (!SubmitDecode(Timestamps)) return false;
+      return PublishDecoded(false, 0);
+    }
+
+    return RetrieveAndPublish(Timestamps);
+  } catch (cv::Exception& e) {
+    UE_LOG(OpenCV, Warning, TEXT("Function %s: Caught OpenCV Exception: %s"), TEXT(__FUNCTION__),
+           UTF8_TO_TCHAR(e.what()));
+    return false;
+  }
+  return true;
+}
+
+uint32 FCVCaptureWorker::Run() {
+  if (!Open()) return 1;
+
+  while (ReadFrame()) {
+  }
+  return 0;
+}
@@ -0,0 +1,232 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "HAL/CriticalSection.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Templates/UniquePtr.h"
+
+#include <atomic>
+
+#include "Classes/CVCaptureTypes.h"
+#include "CVFrameRing.h"
+#include "CVLatencyTracker.h"
+#include "CVProcessingChain.h"
+#include "CVVideoIndex.h"
+
+THIRD_PARTY_INCLUDES_START
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+THIRD_PARTY_INCLUDES_END
+
+class FRunnableThread;
+
+// What a capture worker opens and how it delivers the frames
+struct FCVCaptureSettings {
+  // Camera device to open, a negative ID opens VideoFile instead
+  int32 CameraID = 0;
+  FString VideoFile;
+
+  // Resize every frame to ResizeTo (if set) before it is published
+  bool bResize = false;
+  cv::Size ResizeTo;
+
+  // Maximum number of frames per second, 0 to read as fast as the source delivers
+  float FrameRate = 0.f;
+
+  // Play video files in real time according to their timestamps instead of at FrameRate
+  bool bPaceByTimestamps = false;
+
+  // Fetch camera frames as compressed MJPG and decode them on the engine thread pool, with up to
+  // MaxDecodesInFlight frames being decoded at once
+  bool bParallelMJPEG = false;
+  int32 MaxDecodesInFlight = 4;
+
+  // Processing applied to every frame (after resizing) before it is published
+  TArray<FCVProcessingStage> ProcessingChain;
+
+  // Build a frame index of VideoFile (cached next to the video) for seeking by time, and keep the
+  // FrameCacheSize most recently seeked frames for scrubbing back and forth
+  bool bScrubbing = false;
+  int32 FrameCacheSize = 32;
+
+  // Seek targets at most this many frames ahead are reached by reading forward instead of seeking
+  // from the previous keyframe, 0 for one second of frames
+  int32 MaxForwardGrab = 0;
+
+  // How frames are queued for the consumer, and how many frames can be queued
+  ECVFrameQueuePolicy QueuePolicy = ECVFrameQueuePolicy::LatestOnly;
+  int32 QueueCapacity = 3;
+};
+
+// A frame as it is handed from the capture thread to the consumer
+struct FCVCaptureFrame {
+  cv::UMat Image;
+  // Running number of the frame in the stream, starting at 1
+  int64 FrameNumber = 0;
+  // Position of the frame in the stream in seconds (CAP_PROP_POS_MSEC)
+  double StreamTime = 0.0;
+  // When the frame passed each step of the pipeline. Timestamps.Grab is taken right after the
+  // frame was grabbed and is comparable across streams.
+  FCVFrameTimestamps Timestamps;
+};
+
+/**
+ * Opens a video stream and reads it on a dedicated thread, so camera and decoder latency never
+ * block the game thread. Frames are passed to a single consumer thread through a ring of
+ * preallocated frames, the queue policy decides which frames are dropped if the consumer is slow.
+ *
+ * Instead of starting the thread, the stream can also be driven step by step with Open() and
+ * ReadFrame() from a thread pool, as long as only one thread at a time does so.
+ */
+class FCVCaptureWorker : public FRunnable {
+public:
+  explicit FCVCaptureWorker(const FCVCaptureSettings& Settings);
+  // Stops and joins the capture thread
+  virtual ~FCVCaptureWorker();
+
+  // Starts the capture thread
+  void Start();
+
+  // Opens the stream, returns false if that failed. Called by the capture thread.
+  bool Open();
+
+  // Reads, paces and publishes the next frame (or skips a late one). Returns false once the stream
+  // has ended, failed or Stop() was called. Called by the capture thread after Open().
+  bool ReadFrame();
+
+  /**
+   * Takes the next queued frame (see FCVCaptureSettings::QueuePolicy), returns false if there is
+   * none. The image is not written to anymore while OutFrame references it.
+   */
+  bool PopFrame(FCVCaptureFrame& OutFrame);
+
+  // Number of frames waiting for the consumer
+  int32 GetQueueDepth() const { return Queue.Num(); }
+
+  // Number of frames dropped by the queue policy so far
+  int32 GetNumDroppedFrames() const { return Queue.GetNumDropped(); }
+
+  // Number of late frames that were grabbed but not retrieved (bPaceByTimestamps)
+  int32 GetNumSkippedFrames() const { return NumSkipped.GetValue(); }
+
+  // Requests a seek to a frame (starting at 0) or to a time in seconds. Seeks are served by the
+  // capture thread before the next frame is read, only the most recent request is served.
+  // Cameras cannot seek, requests are ignored with a warning.
+  void SeekToFrame(int64 Frame);
+  void SeekToTime(double Time);
+
+  // Pauses or resumes reading frames, seeks are still served while paused
+  void SetPaused(bool bPause) { bPaused = bPause; }
+
+  // Number of frames of the video file, 0 until the frame index is ready (bScrubbing)
+  int64 GetFrameCount() const { return bIndexReady ? Index.Num() : 0; }
+
+  // True once the stream has been opened, false again when it ends
+  bool IsOpen() const { return bIsOpen; }
+
+  // The stream. It is owned by the capture thread, so only touch it while that is not running.
+  cv::VideoCapture& GetCapture() { return Capture; }
+
+  //~ Begin FRunnable Interface
+  virtual uint32 Run() override;
+  virtual void Stop() override { bStopRequested = true; }
+  //~ End FRunnable Interface
+
+private:
+  // Waits for a free queue slot (FifoBackpressure) and prepares it for writing, returns nullptr if
+  // the thread should stop
+  FCVCaptureFrame* AcquireSlot();
+
+  // Retrieves, processes and publishes the grabbed frame. OutImage receives the published image,
+  // it stays empty if processing failed and the frame was dropped.
+  bool RetrieveAndPublish(FCVFrameTimestamps& Timestamps, cv::UMat* OutImage = nullptr);
+
+  // Serves a pending seek request, bOutServed tells whether there was one. Returns false if the
+  // stream failed.
+  bool ServeSeek(bool& bOutServed);
+
+  // Positions the capture so that the next grab() reads frame Target, either by reading forward
+  // or by seeking
+  bool MoveCaptureTo(int64 Target);
+
+  // Resizes and processes a retrieved frame into a queue slot. Returns false if the processing
+  // chain failed on the frame.
+  bool ProcessFrame(const cv::UMat& Src, cv::UMat& Dst, FCVFrameTimestamps& Timestamps);
+
+  // Retrieves the grabbed compressed frame and queues it for decoding (bParallelMJPEG)
+  bool SubmitDecode(const FCVFrameTimestamps& Timestamps);
+
+  // Publishes decoded frames in sequence order until the next one is still being decoded, or
+  // until at most MaxInFlight decodes are left if bWait is set
+  bool PublishDecoded(bool bWait, int32 MaxInFlight);
+
+  // Waits for all decodes in flight and publishes them unless the thread should stop
+  void FlushDecodes();
+
+  // ReadFrame() without the bookkeeping for the end of the stream
+  bool ReadNextFrame();
+
+  // Sleeps until the given FPlatformTime::Seconds(), returns false if the thread should stop
+  bool WaitUntil(double Time) const;
+
+  // True if the frame due at Due would be dropped from the queue before the consumer can pop it,
+  // because the consumer still has not taken the previous one and newer frames are due first
+  bool IsSupersededBeforePop(double Due) const;
+
+  FCVCaptureSettings Settings;
+  FCVProcessingChain Processing;
+  // Frames decoded for seeks (bScrubbing)
+  detail::FCVFrameCache FrameCache;
+  cv::VideoCapture Capture;
+
+  TCVFrameRing<FCVCaptureFrame> Queue;
+  // Frames are read into this before they are resized and processed into a queue slot
+  cv::UMat RawFrame;
+  cv::UMat ResizedFrame;
+
+  // A compressed frame that is decoded on the thread pool
+  struct FDecodeJob;
+  // Ring of decode jobs indexed by sequence number (bParallelMJPEG)
+  TArray<TUniquePtr<FDecodeJob>> DecodeJobs;
+  // Sequence number of the oldest decode in flight and of the next one to submit
+  int64 NextPublish;
+  int64 NextSubmit;
+
+  // Pacing state of ReadFrame()
+  double FrameInterval;
+  double NextFrameTime;
+  // Number of the last grabbed frame starting at 1, i.e. the index of the next frame to grab
+  int64 FrameNumber;
+  bool bPaceByTimestamps;
+  double FrameDuration;
+  double PlaybackStart;
+  double StreamTime;
+
+  // The latest seek request (either a frame or a time), negative if there is none
+  FCriticalSection SeekLock;
+  int64 SeekFrame;
+  double SeekTime;
+  // Frame the capture has to continue from after a seek was served from the cache, or -1
+  int64 ResumeFrame;
+  FThreadSafeBool bPaused;
+
+  // The frame index is built on its own thread unless it was cached (bScrubbing)
+  detail::FCVVideoIndex Index;
+  FThreadSafeBool bIndexReady;
+  TFuture<void> IndexBuild;
+
+  // When the consumer last popped a frame and the smoothed interval between its pops
+  std::atomic<double> LastPopTime;
+  std::atomic<double> PopInterval;
+
+  FThreadSafeCounter NumSkipped;
+  FThreadSafeBool bIsOpen;
+  FThreadSafeBool bStopRequested;
+  FRunnableThread* Thread;
+};
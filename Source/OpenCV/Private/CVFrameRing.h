@@ -0,0 +1,117 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/PlatformProcess.h"
+
+#include "Classes/CVCaptureTypes.h"
+
+#include <atomic>
+
+/**
+ * Bounded lock-free ring of preallocated frames between exactly one producer thread and one
+ * consumer thread.
+ *
+ * The producer fills the slot returned by BeginWrite in place and publishes it with EndWrite.
+ * What happens when the ring is full depends on the policy: FifoBackpressure makes BeginWrite
+ * return nullptr until the consumer caught up, the other policies drop the oldest queued frame.
+ * With LatestOnly, Pop additionally skips to the newest frame.
+ *
+ * Slots are reused, so a frame that is still referenced after Pop must not be written into by the
+ * producer (e.g. check the reference count of cv::UMat buffers before reusing them).
+ */
+template <typename FrameType> class TCVFrameRing {
+public:
+  TCVFrameRing(int32 Capacity, ECVFrameQueuePolicy InPolicy)
+      : Policy(InPolicy), Head(0), Tail(0), ReadingSlot(INDEX_NONE), NumDropped(0) {
+    // One slot always stays free to tell a full ring from an empty one
+    Slots.SetNum(FMath::Max(Capacity, 1) + 1);
+  }
+
+  // Producer: the slot for the next frame, or nullptr if the frame has to wait (backpressure)
+  FrameType* BeginWrite() {
+    const int32 H = Head.load();
+    int32 T = Tail.load();
+    while (Next(H) == T) {
+      if (Policy == ECVFrameQueuePolicy::FifoBackpressure) {
+        return nullptr;
+      }
+      // Drop the oldest frame, unless the consumer took it in the meantime
+      if (Tail.compare_exchange_strong(T, Next(T))) {
+        ++NumDropped;
+        T = Next(T);
+      }
+    }
+
+    // The consumer might still be copying this slot from the previous round
+    while (ReadingSlot.load() == H) {
+      FPlatformProcess::Yield();
+    }
+    return &Slots[H];
+  }
+
+  // Producer: publishes the slot returned by BeginWrite
+  void EndWrite() { Head.store(Next(Head.load())); }
+
+  // Consumer: takes the next frame (or the newest one for LatestOnly). Returns false if empty.
+  bool Pop(FrameType& OutFrame) {
+    for (;;) {
+      int32 T = Tail.load();
+      if (T == Head.load()) return false;
+
+      // Re-check after announcing the read, the producer won't touch this slot from now on
+      ReadingSlot.store(T);
+      const int32 H = Head.load();
+      if (T == H) {
+        ReadingSlot.store(INDEX_NONE);
+        return false;
+      }
+
+      if (Policy == ECVFrameQueuePolicy::LatestOnly && Next(T) != H) {
+        // Skip everything but the newest frame
+        const int32 Newest = Prev(H);
+        if (Tail.compare_exchange_strong(T, Newest)) {
+          NumDropped += Distance(T, Newest);
+        }
+        ReadingSlot.store(INDEX_NONE);
+        continue;
+      }
+
+      OutFrame = Slots[T];
+      const bool bClaimed = Tail.compare_exchange_strong(T, Next(T));
+      ReadingSlot.store(INDEX_NONE);
+      // If the producer dropped this frame while it was copied, try the next one
+      if (bClaimed) return true;
+    }
+  }
+
+  // Number of frames currently queued
+  int32 Num() const { return Distance(Tail.load(), Head.load()); }
+
+  int32 GetCapacity() const { return Slots.Num() - 1; }
+
+  // Number of frames that were dropped because of the policy
+  int32 GetNumDropped() const { return NumDropped.load(); }
+
+  ECVFrameQueuePolicy GetPolicy() const { return Policy; }
+
+private:
+  int32 Next(int32 Index) const { return Index + 1 == Slots.Num() ? 0 : Index + 1; }
+  int32 Prev(int32 Index) const { return Index == 0 ? Slots.Num() - 1 : Index - 1; }
+  int32 Distance(int32 From, int32 To) const {
+    return To >= From ? To - From : To + Slots.Num() - From;
+  }
+
+  const ECVFrameQueuePolicy Policy;
+  TArray<FrameType> Slots;
+
+  // Next slot the producer writes, written by the producer only
+  std::atomic<int32> Head;
+  // Oldest queued slot, advanced by the consumer and by the producer when it drops frames
+  std::atomic<int32> Tail;
+  // Slot the consumer is currently copying from
+  std::atomic<int32> ReadingSlot;
+  std::atomic<int32> NumDropped;
+};
@@ -0,0 +1,42 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#include "CVImageProcKernels.h"
+
+THIRD_PARTY_INCLUDES_START
+#include <opencv2/imgproc.hpp>
+THIRD_PARTY_INCLUDES_END
+
+namespace detail {
+
+void GaussianFilter(const cv::UMat& Src, cv::UMat& Dst, float Sigma) {
+  int ksize = int(3 * Sigma);
+  if (!(ksize % 2)) ksize++;
+  cv::GaussianBlur(Src, Dst, cv::Size(ksize, ksize), Sigma, Sigma);
+}
+
+void MedianFilter(const cv::UMat& Src, cv::UMat& Dst, int32 FilterSize) {
+  cv::medianBlur(Src, Dst, FilterSize);
+}
+
+void BilateralFilter(const cv::UMat& Src, cv::UMat& Dst, int32 Diameter, float SigmaColor,
+                     float SigmaSpace) {
+  cv::bilateralFilter(Src, Dst, Diameter, SigmaColor, SigmaSpace);
+}
+
+void ComputeUndistortMaps(const cv::Size& Size, const FVector2D& FocalLength,
+                          const FVector2D& PrincipalPoint, const TArray<float>& Distortion,
+                          cv::UMat& Map1, cv::UMat& Map2) {
+  const cv::Matx33d CameraMatrix(FocalLength.X, 0, PrincipalPoint.X,  //
+                                 0, FocalLength.Y, PrincipalPoint.Y,  //
+                                 0, 0, 1);
+  cv::Mat Coefficients(1, Distortion.Num(), CV_32F, const_cast<float*>(Distortion.GetData()));
+  cv::initUndistortRectifyMap(CameraMatrix, Coefficients, cv::noArray(), CameraMatrix, Size,
+                              CV_16SC2, Map1, Map2);
+}
+
+void Undistort(const cv::UMat& Src, cv::UMat& Dst, const cv::UMat& Map1, const cv::UMat& Map2) {
+  cv::remap(Src, Dst, Map1, Map2, cv::INTER_LINEAR);
+}
+
+}  // namespace detail
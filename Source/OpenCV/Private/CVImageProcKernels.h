@@ -0,0 +1,34 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+THIRD_PARTY_INCLUDES_START
+#include <opencv2/core.hpp>
+THIRD_PARTY_INCLUDES_END
+
+// Image operations shared by the Blueprint library and the capture processing chain. They work
+// on plain matrices and throw cv::Exception on errors.
+namespace detail {
+
+// Gaussian blur with a kernel of about 3 sigma
+void GaussianFilter(const cv::UMat& Src, cv::UMat& Dst, float Sigma);
+
+void MedianFilter(const cv::UMat& Src, cv::UMat& Dst, int32 FilterSize);
+
+void BilateralFilter(const cv::UMat& Src, cv::UMat& Dst, int32 Diameter, float SigmaColor,
+                     float SigmaSpace);
+
+// Computes the remap tables that undistort images of the given size for a pinhole camera with
+// focal length and principal point in pixels and OpenCV distortion coefficients (none, or 4, 5, 8,
+// 12 or 14 of k1, k2, p1, p2[, k3, ...])
+void ComputeUndistortMaps(const cv::Size& Size, const FVector2D& FocalLength,
+                          const FVector2D& PrincipalPoint, const TArray<float>& Distortion,
+                          cv::UMat& Map1, cv::UMat& Map2);
+
+// Undistorts Src with the tables of ComputeUndistortMaps, Dst may not alias Src
+void Undistort(const cv::UMat& Src, cv::UMat& Dst, const cv::UMat& Map1, const cv::UMat& Map2);
+
+}  // namespace detail
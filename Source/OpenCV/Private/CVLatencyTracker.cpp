@@ -0,0 +1,132 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#include "CVLatencyTracker.h"
+
+#include "OpenCV_Common.h"
+
+#include "HAL/PlatformTime.h"
+#include "Misc/ScopeLock.h"
+#include "RenderingThread.h"
+
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Latency Total (ms)"), STAT_OpenCV_Latency, STATGROUP_OpenCV);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Latency Total p50 (ms)"), STAT_OpenCV_LatencyP50,
+                           STATGROUP_OpenCV);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Latency Total p95 (ms)"), STAT_OpenCV_LatencyP95,
+                           STATGROUP_OpenCV);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Latency Total p99 (ms)"), STAT_OpenCV_LatencyP99,
+                           STATGROUP_OpenCV);
+
+FCVRollingPercentiles::FCVRollingPercentiles(int32 InWindowSize)
+    : Next(0), WindowSize(FMath::Max(InWindowSize, 1)) {
+  Values.Reserve(WindowSize);
+  Sorted.Reserve(WindowSize);
+}
+
+void FCVRollingPercentiles::Add(float Value) {
+  if (Values.Num() < WindowSize) {
+    Values.Add(Value);
+  } else {
+    Values[Next] = Value;
+  }
+  Next = (Next + 1) % WindowSize;
+}
+
+float FCVRollingPercentiles::GetPercentile(float P) const {
+  if (Values.Num() == 0) return 0.f;
+
+  // The window is small, sorting a copy is cheaper than maintaining an order statistic tree
+  Sorted = Values;
+  Sorted.Sort();
+  const int32 Rank = FMath::RoundToInt(FMath::Clamp(P, 0.f, 100.f) / 100.f * (Sorted.Num() - 1));
+  return Sorted[Rank];
+}
+
+FCVLatencyTracker::FCVLatencyTracker(int32 WindowSize)
+    : Decode(WindowSize),
+      Resize(WindowSize),
+      Process(WindowSize),
+      Queue(WindowSize),
+      Upload(WindowSize),
+      Render(WindowSize),
+      Total(WindowSize) {}
+
+void FCVLatencyTracker::BeginUpload(const FCVFrameTimestamps& Timestamps) {
+  Uploading = Timestamps;
+  Uploading.Pop = FPlatformTime::Seconds();
+}
+
+void FCVLatencyTracker::EndUpload(
+    const TSharedRef<FCVLatencyTracker, ESPMode::ThreadSafe>& InTracker) {
+  using FTrackerRef = TSharedRef<FCVLatencyTracker, ESPMode::ThreadSafe>;
+  FCVFrameTimestamps Timestamps = InTracker->Uploading;
+  Timestamps.UploadEnqueue = FPlatformTime::Seconds();
+
+  // Render commands execute in order, so this runs after the texture update of the frame
+  ENQUEUE_UNIQUE_RENDER_COMMAND_TWOPARAMETER(
+      CompleteCVFrameLatency, FTrackerRef, Tracker, InTracker, FCVFrameTimestamps, Enqueued,
+      Timestamps, {
+        FCVFrameTimestamps Completed = Enqueued;
+        Completed.UploadComplete = FPlatformTime::Seconds();
+        Tracker->AddCompletedFrame(Completed);
+      });
+}
+
+void FCVLatencyTracker::AddCompletedFrame(const FCVFrameTimestamps& Timestamps) {
+  FScopeLock Lock(&CompletedLock);
+  Completed.Add(Timestamps);
+}
+
+FCVFrameLatency FCVLatencyTracker::GetLatency(const FCVFrameTimestamps& T) {
+  const auto Ms = [](double From, double To) { return static_cast<float>((To - From) * 1000.0); };
+
+  FCVFrameLatency Latency;
+  Latency.DecodeMs = Ms(T.Grab, T.Retrieve);
+  Latency.ResizeMs = Ms(T.Retrieve, T.Resize);
+  Latency.ProcessMs = Ms(T.Resize, T.Process);
+  Latency.QueueMs = Ms(T.Publish, T.Pop);
+  Latency.UploadMs = Ms(T.Pop, T.UploadEnqueue);
+  Latency.RenderMs = Ms(T.UploadEnqueue, T.UploadComplete);
+  Latency.TotalMs = Ms(T.Grab, T.UploadComplete);
+  return Latency;
+}
+
+bool FCVLatencyTracker::Update(FCVFrameLatency& OutLatest, FCVFrameLatency& OutP50,
+                               FCVFrameLatency& OutP95, FCVFrameLatency& OutP99) {
+  {
+    FScopeLock Lock(&CompletedLock);
+    Swap(Completed, Processing);
+  }
+  if (Processing.Num() == 0) return false;
+
+  for (const FCVFrameTimestamps& Timestamps : Processing) {
+    OutLatest = GetLatency(Timestamps);
+    Decode.Add(OutLatest.DecodeMs);
+    Resize.Add(OutLatest.ResizeMs);
+    Process.Add(OutLatest.ProcessMs);
+    Queue.Add(OutLatest.QueueMs);
+    Upload.Add(OutLatest.UploadMs);
+    Render.Add(OutLatest.RenderMs);
+    Total.Add(OutLatest.TotalMs);
+  }
+  Processing.Reset();
+
+  const auto Summarise = [this](float P, FCVFrameLatency& Out) {
+    Out.DecodeMs = Decode.GetPercentile(P);
+    Out.ResizeMs = Resize.GetPercentile(P);
+    Out.ProcessMs = Process.GetPercentile(P);
+    Out.QueueMs = Queue.GetPercentile(P);
+    Out.UploadMs = Upload.GetPercentile(P);
+    Out.RenderMs = Render.GetPercentile(P);
+    Out.TotalMs = Total.GetPercentile(P);
+  };
+  Summarise(50.f, OutP50);
+  Summarise(95.f, OutP95);
+  Summarise(99.f, OutP99);
+
+  SET_FLOAT_STAT(STAT_OpenCV_Latency, OutLatest.TotalMs);
+  SET_FLOAT_STAT(STAT_OpenCV_LatencyP50, OutP50.TotalMs);
+  SET_FLOAT_STAT(STAT_OpenCV_LatencyP95, OutP95.TotalMs);
+  SET_FLOAT_STAT(STAT_OpenCV_LatencyP99, OutP99.TotalMs);
+  return true;
+}
@@ -0,0 +1,78 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+
+#include "Classes/CVCaptureTypes.h"
+
+// When a frame passed each step of the capture to texture pipeline, in FPlatformTime::Seconds().
+// Steps that were skipped get the time of the step before, so they count as taking no time.
+struct FCVFrameTimestamps {
+  double Grab = 0.0;
+  double Retrieve = 0.0;
+  double Resize = 0.0;
+  double Process = 0.0;
+  double Publish = 0.0;
+  double Pop = 0.0;
+  double UploadEnqueue = 0.0;
+  double UploadComplete = 0.0;
+};
+
+// The last WindowSize values of a series and their percentiles
+class FCVRollingPercentiles {
+public:
+  explicit FCVRollingPercentiles(int32 WindowSize);
+
+  void Add(float Value);
+
+  // The P-th percentile (0 to 100) of the values in the window, 0 if there are none
+  float GetPercentile(float P) const;
+
+private:
+  TArray<float> Values;
+  int32 Next;
+  int32 WindowSize;
+  mutable TArray<float> Sorted;
+};
+
+/**
+ * Collects the timestamps of uploaded frames and summarises them as per-step latencies.
+ * The render thread adds frames once their texture update has executed, the game thread turns
+ * them into the latency of the latest frame, rolling percentiles and the "stat OpenCV" counters.
+ */
+class FCVLatencyTracker {
+public:
+  explicit FCVLatencyTracker(int32 WindowSize = 256);
+
+  // Called on the game thread with the frame that is uploaded next, stamps it as picked up
+  void BeginUpload(const FCVFrameTimestamps& Timestamps);
+
+  // Called on the game thread once the upload of that frame has been enqueued. Enqueues a render
+  // command that completes the frame after the texture update has executed.
+  static void EndUpload(const TSharedRef<FCVLatencyTracker, ESPMode::ThreadSafe>& InTracker);
+
+  // Called on the render thread for every frame whose texture update has been executed
+  void AddCompletedFrame(const FCVFrameTimestamps& Timestamps);
+
+  // Called on the game thread, processes the completed frames. Returns false if there were none.
+  bool Update(FCVFrameLatency& OutLatest, FCVFrameLatency& OutP50, FCVFrameLatency& OutP95,
+              FCVFrameLatency& OutP99);
+
+  // The latencies of a single frame
+  static FCVFrameLatency GetLatency(const FCVFrameTimestamps& Timestamps);
+
+private:
+  // The frame between BeginUpload and EndUpload (game thread only)
+  FCVFrameTimestamps Uploading;
+
+  FCriticalSection CompletedLock;
+  TArray<FCVFrameTimestamps> Completed;
+  // Swapped with Completed, so Update() does not hold the lock while summarising
+  TArray<FCVFrameTimestamps> Processing;
+
+  // One series per field of FCVFrameLatency
+  FCVRollingPercentiles Decode, Resize, Process, Queue, Upload, Render, Total;
+};
@@ -0,0 +1,87 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#include "CVProcessingChain.h"
+
+#include "CVImageProcKernels.h"
+#include "OpenCV_Common.h"
+
+THIRD_PARTY_INCLUDES_START
+#include <opencv2/imgproc.hpp>
+THIRD_PARTY_INCLUDES_END
+
+namespace {
+bool IsValidStage(const FCVProcessingStage& Stage) {
+  switch (Stage.Operation) {
+    case ECVProcessingOperation::GaussianFilter: return Stage.Sigma > 0.f;
+    case ECVProcessingOperation::MedianFilter:
+      return Stage.FilterSize > 1 && Stage.FilterSize % 2 == 1;
+    case ECVProcessingOperation::Undistort: {
+      // The coefficient counts cv::initUndistortRectifyMap accepts
+      const int32 NumCoefficients = Stage.DistortionCoefficients.Num();
+      return NumCoefficients == 0 || NumCoefficients == 4 || NumCoefficients == 5 ||
+             NumCoefficients == 8 || NumCoefficients == 12 || NumCoefficients == 14;
+    }
+    default: return true;
+  }
+}
+}  // namespace
+
+FCVProcessingChain::FCVProcessingChain(const TArray<FCVProcessingStage>& InStages)
+    : bReportedError(false) {
+  for (int32 i = 0; i < InStages.Num(); ++i) {
+    if (IsValidStage(InStages[i])) {
+      Stages.Add(InStages[i]);
+    } else {
+      UE_LOG(OpenCV, Error, TEXT("Processing stage %d has invalid parameters and is skipped!"), i);
+    }
+  }
+  UndistortMaps.SetNum(Stages.Num());
+  Intermediates.SetNum(FMath::Max(Stages.Num() - 1, 0));
+}
+
+bool FCVProcessingChain::Apply(const cv::UMat& Src, cv::UMat& Dst) {
+  int32 i = 0;
+  try {
+    for (; i < Stages.Num(); ++i) {
+      const FCVProcessingStage& Stage = Stages[i];
+      const cv::UMat& Image = i > 0 ? Intermediates[i - 1] : Src;
+      cv::UMat& Result = i + 1 < Stages.Num() ? Intermediates[i] : Dst;
+
+      switch (Stage.Operation) {
+        case ECVProcessingOperation::GaussianFilter:
+          detail::GaussianFilter(Image, Result, Stage.Sigma);
+          break;
+        case ECVProcessingOperation::MedianFilter:
+          detail::MedianFilter(Image, Result, Stage.FilterSize);
+          break;
+        case ECVProcessingOperation::BilateralFilter:
+          detail::BilateralFilter(Image, Result, Stage.Diameter, Stage.SigmaColor,
+                                  Stage.SigmaSpace);
+          break;
+        case ECVProcessingOperation::Undistort: {
+          FUndistortMaps& Maps = UndistortMaps[i];
+          if (Maps.Size != Image.size()) {
+            detail::ComputeUndistortMaps(Image.size(), Stage.FocalLength, Stage.PrincipalPoint,
+                                         Stage.DistortionCoefficients, Maps.Map1, Maps.Map2);
+            Maps.Size = Image.size();
+          }
+          detail::Undistort(Image, Result, Maps.Map1, Maps.Map2);
+          break;
+        }
+        case ECVProcessingOperation::ConvertColor:
+          cv::cvtColor(Image, Result, Stage.ColorConversion);
+          break;
+        default: Image.copyTo(Result); break;
+      }
+    }
+  } catch (cv::Exception& e) {
+    if (!bReportedError) {
+      UE_LOG(OpenCV, Warning, TEXT("Processing stage %d failed, dropping frames: %s"), i,
+             UTF8_TO_TCHAR(e.what()));
+      bReportedError = true;
+    }
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,47 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "Classes/CVCaptureTypes.h"
+
+THIRD_PARTY_INCLUDES_START
+#include <opencv2/core.hpp>
+THIRD_PARTY_INCLUDES_END
+
+/**
+ * Runs an ordered list of processing stages on the frames of a stream.
+ * Every stage but the last writes into its own intermediate buffer, so once the frame size is
+ * stable no stage allocates. Undistortion tables are computed once per stage and frame size.
+ *
+ * Stages with invalid parameters are dropped when the chain is created. Errors that only show up
+ * with the actual frames (e.g. a color conversion that does not fit the channel count) make Apply
+ * fail for that frame; they are logged once per chain.
+ */
+class FCVProcessingChain {
+public:
+  explicit FCVProcessingChain(const TArray<FCVProcessingStage>& Stages);
+
+  bool IsEmpty() const { return Stages.Num() == 0; }
+
+  // Runs all stages on Src and writes the result into Dst, which may not alias Src. Returns false
+  // if a stage failed, Dst is undefined then.
+  bool Apply(const cv::UMat& Src, cv::UMat& Dst);
+
+private:
+  struct FUndistortMaps {
+    cv::Size Size;
+    cv::UMat Map1;
+    cv::UMat Map2;
+  };
+
+  TArray<FCVProcessingStage> Stages;
+  // Undistortion tables of each stage (only used for Undistort stages)
+  TArray<FUndistortMaps> UndistortMaps;
+  // Output of each stage but the last
+  TArray<cv::UMat> Intermediates;
+  // Only the first failure is logged, a misconfigured stage fails on every frame
+  bool bReportedError;
+};
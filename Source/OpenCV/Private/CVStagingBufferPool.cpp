@@ -0,0 +1,118 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#include "CVStagingBufferPool.h"
+
+#include "HAL/UnrealMemory.h"
+#include "Math/UnrealMathUtility.h"
+
+namespace {
+// Alignment of the staging buffers, large enough for any SIMD loads/stores on the data
+constexpr uint32 StagingBufferAlignment = 64;
+
+// Default high-water mark, enough for a handful of 4K BGRA frames in flight
+constexpr SIZE_T DefaultMaxPooledBytes = 256ull * 1024ull * 1024ull;
+}  // namespace
+
+FCVStagingBufferPool& FCVStagingBufferPool::Get() {
+  static FCVStagingBufferPool Instance;
+  return Instance;
+}
+
+FCVStagingBufferPool::FCVStagingBufferPool()
+    : PooledBytes(0), MaxPooledBytes(DefaultMaxPooledBytes) {}
+
+FCVStagingBufferPool::~FCVStagingBufferPool() { Trim(); }
+
+SIZE_T FCVStagingBufferPool::GetBucketSize(SIZE_T Size) {
+  // Round small requests up to 4k, everything above to a quarter of the next lower power of two
+  if (Size <= 4096) return 4096;
+
+  const uint32 Log2 = FMath::FloorLog2_64(static_cast<uint64>(Size));
+  const SIZE_T Step = (SIZE_T(1) << Log2) / 4;
+  return ((Size + Step - 1) / Step) * Step;
+}
+
+FCVStagingBuffer FCVStagingBufferPool::Acquire(SIZE_T Size) {
+  FCVStagingBuffer Buffer;
+  Buffer.Capacity = GetBucketSize(Size);
+
+  {
+    FScopeLock Lock(&Mutex);
+    TArray<uint8*>* Bucket = Buckets.Find(Buffer.Capacity);
+    if (Bucket && Bucket->Num() > 0) {
+      Buffer.Data = Bucket->Pop(false);
+      PooledBytes -= Buffer.Capacity;
+    }
+  }
+
+  if (Buffer.Data) {
+    Hits.Increment();
+  } else {
+    Misses.Increment();
+    Buffer.Data = static_cast<uint8*>(FMemory::Malloc(Buffer.Capacity, StagingBufferAlignment));
+  }
+  return Buffer;
+}
+
+void FCVStagingBufferPool::Release(FCVStagingBuffer& Buffer) {
+  if (!Buffer.IsValid()) return;
+
+  bool bPooled = false;
+  {
+    FScopeLock Lock(&Mutex);
+    if (PooledBytes + Buffer.Capacity <= MaxPooledBytes) {
+      Buckets.FindOrAdd(Buffer.Capacity).Push(Buffer.Data);
+      PooledBytes += Buffer.Capacity;
+      bPooled = true;
+    }
+  }
+
+  if (!bPooled) {
+    FMemory::Free(Buffer.Data);
+  }
+  Buffer = FCVStagingBuffer{};
+}
+
+void FCVStagingBufferPool::Trim() {
+  FScopeLock Lock(&Mutex);
+  for (auto& Bucket : Buckets) {
+    for (uint8* Data : Bucket.Value) {
+      FMemory::Free(Data);
+    }
+  }
+  Buckets.Empty();
+  PooledBytes = 0;
+}
+
+void FCVStagingBufferPool::TrimToLimit() {
+  for (auto It = Buckets.CreateIterator(); It && PooledBytes > MaxPooledBytes; ++It) {
+    TArray<uint8*>& Bucket = It.Value();
+    while (Bucket.Num() > 0 && PooledBytes > MaxPooledBytes) {
+      FMemory::Free(Bucket.Pop(false));
+      PooledBytes -= It.Key();
+    }
+    if (Bucket.Num() == 0) It.RemoveCurrent();
+  }
+}
+
+void FCVStagingBufferPool::SetMaxPooledBytes(SIZE_T MaxBytes) {
+  FScopeLock Lock(&Mutex);
+  MaxPooledBytes = MaxBytes;
+  TrimToLimit();
+}
+
+SIZE_T FCVStagingBufferPool::GetMaxPooledBytes() const {
+  FScopeLock Lock(&Mutex);
+  return MaxPooledBytes;
+}
+
+SIZE_T FCVStagingBufferPool::GetPooledBytes() const {
+  FScopeLock Lock(&Mutex);
+  return PooledBytes;
+}
+
+void FCVStagingBufferPool::ResetStats() {
+  Hits.Reset();
+  Misses.Reset();
+}
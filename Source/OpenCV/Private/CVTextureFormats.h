@@ -0,0 +1,71 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PixelFormat.h"
+
+THIRD_PARTY_INCLUDES_START
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+THIRD_PARTY_INCLUDES_END
+
+namespace detail {
+
+// Describes how a matrix is laid out in texture memory for an upload
+struct FCVUploadFormat {
+  EPixelFormat PixelFormat;
+  // The OpenCV conversion parameter as used by cv::cvtColor, -1 for a direct copy
+  int32 Conversion;
+  // Bytes per texel of PixelFormat
+  uint32 ElementSize;
+};
+
+// Picks the texture format a matrix of type CvType is uploaded to. Single-channel mats are
+// uploaded as-is to single-channel formats, color mats are expanded to BGRA.
+// Returns false if there is no suitable format.
+inline bool NegotiateUploadFormat(int32 CvType, FCVUploadFormat &OutFormat) {
+  switch (CvType) {
+    case CV_8UC1: OutFormat = {PF_G8, -1, 1}; return true;
+    case CV_16UC1: OutFormat = {PF_G16, -1, 2}; return true;
+    case CV_32FC1: OutFormat = {PF_R32_FLOAT, -1, 4}; return true;
+    case CV_8UC3: OutFormat = {PF_B8G8R8A8, cv::COLOR_BGR2BGRA, 4}; return true;
+    case CV_8UC4: OutFormat = {PF_B8G8R8A8, -1, 4}; return true;
+    default: return false;
+  }
+}
+
+// Picks the volume texture format a single-channel 3D matrix of type CvType is uploaded to.
+// Unsigned and float volumes are uploaded as-is. CV_16SC1 holds integers (e.g. CT in Hounsfield
+// units) that are converted to half floats for PF_R16F, see CopyVolumeVoxels.
+// Returns false if there is no suitable format.
+inline bool NegotiateVolumeFormat(int32 CvType, FCVUploadFormat &OutFormat) {
+  switch (CvType) {
+    case CV_8UC1: OutFormat = {PF_G8, -1, 1}; return true;
+    case CV_16UC1: OutFormat = {PF_G16, -1, 2}; return true;
+    case CV_16SC1: OutFormat = {PF_R16F, -1, 2}; return true;
+    case CV_32FC1: OutFormat = {PF_R32_FLOAT, -1, 4}; return true;
+    default: return false;
+  }
+}
+
+// Returns the OpenCV matrix type that matches the memory layout of a pixel format, or -1 if the
+// format has no direct equivalent. Half-float formats are returned as 16S following the
+// convention of cv::convertFp16.
+inline int32 PixelFormatToCvType(EPixelFormat Format) {
+  switch (Format) {
+    case PF_G8:
+    case PF_A8: return CV_8UC1;
+    case PF_B8G8R8A8:
+    case PF_R8G8B8A8: return CV_8UC4;
+    case PF_G16: return CV_16UC1;
+    case PF_R16F: return CV_16SC1;
+    case PF_R32_FLOAT: return CV_32FC1;
+    case PF_FloatRGBA: return CV_16SC4;
+    case PF_A32B32G32R32F: return CV_32FC4;
+    default: return -1;
+  }
+}
+
+}  // namespace detail
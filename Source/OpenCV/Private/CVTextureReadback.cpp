@@ -0,0 +1,394 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#include "CVTextureReadback.h"
+
+#include "CVTextureFormats.h"
+#include "CVVolumeSlabCopy.h"
+#include "OpenCV_Common.h"
+
+#include "Async/Async.h"
+#include "CoreGlobals.h"
+#include "Engine/Texture.h"
+#include "Engine/VolumeTexture.h"
+#include "HAL/ThreadSafeBool.h"
+#include "RenderCommandFence.h"
+#include "RenderingThread.h"
+#include "RHI.h"
+#include "RHICommandList.h"
+#include "TextureResource.h"
+
+namespace {
+constexpr int32 DefaultRingSize = 3;
+constexpr int32 DefaultReadbackLatency = 2;
+}  // namespace
+
+struct FCVTextureReadback::FSlot {
+  enum class EState : uint8 { Free, Copying, Mapping };
+
+  // Game thread state
+  EState State{EState::Free};
+  FRenderCommandFence CopyFence;
+  uint64 CopyFrame{0};
+  FOnReadbackComplete OnComplete;
+
+  // Render thread state
+  FTexture2DRHIRef StagingTexture;
+  FIntPoint Size{0, 0};
+  int32 CvType{-1};
+};
+
+struct FCVTextureReadback::FSlabSlot {
+  enum class EState : uint8 { Free, Copying, Mapping };
+
+  // Game thread state
+  EState State{EState::Free};
+  FRenderCommandFence Fence;
+  uint64 CopyFrame{0};
+  // First and one past the last slice of the slab
+  FIntPoint Slab{0, 0};
+
+  // Render thread state
+  FTexture2DRHIRef SlabTexture;
+  FUnorderedAccessViewRHIRef SlabUAV;
+  FTexture2DRHIRef StagingTexture;
+};
+
+struct FCVTextureReadback::FVolumeJob {
+  // Game thread state. The resource is only compared against, never dereferenced: it is freed
+  // when the texture is garbage collected or recreates its resource.
+  TWeakObjectPtr<UVolumeTexture> Texture;
+  FTextureResource* Resource{nullptr};
+  FIntVector Size{0, 0, 0};
+  EPixelFormat Format{PF_Unknown};
+  int32 SlicesPerFrame{1};
+  int32 NextSlice{0};
+  TArray<FSlabSlotPtr> SlabSlots;
+  FOnReadbackComplete OnComplete;
+
+  // Written slab by slab on the render thread
+  cv::UMat Result;
+  cv::Mat ResultMapped;
+  FThreadSafeBool bFailed{false};
+};
+
+FCVTextureReadback& FCVTextureReadback::Get() {
+  static FCVTextureReadback Instance;
+  return Instance;
+}
+
+FCVTextureReadback::FCVTextureReadback() : ReadbackLatency(DefaultReadbackLatency) {
+  SetRingSize(DefaultRingSize);
+}
+
+FCVTextureReadback::~FCVTextureReadback() {
+  if (TickHandle.IsValid()) {
+    FTicker::GetCoreTicker().RemoveTicker(TickHandle);
+  }
+}
+
+void FCVTextureReadback::SetRingSize(int32 NumSlots) {
+  check(IsInGameThread());
+  NumSlots = FMath::Max(NumSlots, 1);
+
+  while (Slots.Num() < NumSlots) {
+    Slots.Add(MakeShared<FSlot, ESPMode::ThreadSafe>());
+  }
+  // Only free slots can be dropped, in-flight readbacks still need to complete
+  for (int32 i = Slots.Num() - 1; i >= 0 && Slots.Num() > NumSlots; --i) {
+    if (Slots[i]->State == FSlot::EState::Free) {
+      Slots.RemoveAt(i);
+    }
+  }
+}
+
+int32 FCVTextureReadback::GetNumInFlight() const {
+  int32 NumInFlight = VolumeJobs.Num();
+  for (const FSlotPtr& Slot : Slots) {
+    if (Slot->State != FSlot::EState::Free) ++NumInFlight;
+  }
+  return NumInFlight;
+}
+
+bool FCVTextureReadback::Enqueue(UTexture* Texture, FOnReadbackComplete OnComplete) {
+  check(IsInGameThread());
+
+  if (!Texture || !Texture->Resource) {
+    UE_LOG(OpenCV, Error, TEXT("Cannot read back a texture without a resource!"));
+    return false;
+  }
+
+  FSlotPtr* FreeSlot = Slots.FindByPredicate(
+      [](const FSlotPtr& Slot) { return Slot->State == FSlot::EState::Free; });
+  if (!FreeSlot) {
+    UE_LOG(OpenCV, Verbose, TEXT("All %d readback slots are in flight, dropping request."),
+           Slots.Num());
+    return false;
+  }
+
+  FSlotPtr Slot = *FreeSlot;
+  Slot->State = FSlot::EState::Copying;
+  Slot->OnComplete = MoveTemp(OnComplete);
+
+  ENQUEUE_UNIQUE_RENDER_COMMAND_TWOPARAMETER(
+      CopyTextureToCVReadbackSlot, FSlotPtr, Slot, Slot, FTextureResource*, Resource,
+      Texture->Resource, {
+        Slot->CvType = -1;
+
+        FTexture2DRHIRef SourceRHI =
+            Resource->TextureRHI ? Resource->TextureRHI->GetTexture2D() : nullptr;
+        if (!SourceRHI) return;
+
+        const EPixelFormat Format = SourceRHI->GetFormat();
+        Slot->CvType = detail::PixelFormatToCvType(Format);
+        if (Slot->CvType == -1) return;
+
+        Slot->Size = SourceRHI->GetSizeXY();
+        if (!Slot->StagingTexture || Slot->StagingTexture->GetSizeXY() != Slot->Size ||
+            Slot->StagingTexture->GetFormat() != Format) {
+          FRHIResourceCreateInfo CreateInfo;
+          Slot->StagingTexture = RHICreateTexture2D(Slot->Size.X, Slot->Size.Y, Format, 1, 1,
+                                                    TexCreate_CPUReadback, CreateInfo);
+        }
+
+        RHICmdList.CopyToResolveTarget(SourceRHI, Slot->StagingTexture, FResolveParams());
+      });
+
+  Slot->CopyFence.BeginFence();
+  Slot->CopyFrame = GFrameCounter;
+
+  StartTicking();
+  return true;
+}
+
+bool FCVTextureReadback::EnqueueVolume(UVolumeTexture* Texture, FOnReadbackComplete OnComplete,
+                                       int32 SlicesPerFrame) {
+  check(IsInGameThread());
+
+  if (!Texture || !Texture->Resource) {
+    UE_LOG(OpenCV, Error, TEXT("Cannot read back a texture without a resource!"));
+    return false;
+  }
+  const EPixelFormat Format = Texture->GetPixelFormat();
+  if (!detail::CanCopyVolumeSlab(Format)) {
+    UE_LOG(OpenCV, Error,
+           TEXT("GPU readback of volume textures needs SM5 and PF_G8, PF_G16, PF_R16F, ")
+               TEXT("PF_R32_FLOAT, PF_FloatRGBA or PF_A32B32G32R32F!"));
+    return false;
+  }
+
+  FVolumeJobPtr Job = MakeShared<FVolumeJob, ESPMode::ThreadSafe>();
+  Job->Texture = Texture;
+  Job->Resource = Texture->Resource;
+  Job->Size = FIntVector(Texture->GetSizeX(), Texture->GetSizeY(), Texture->GetSizeZ());
+  Job->Format = Format;
+  Job->SlicesPerFrame = FMath::Max(SlicesPerFrame, 1);
+  Job->OnComplete = MoveTemp(OnComplete);
+  // One slab is copied per frame, so this many are in flight until the first one is mapped
+  for (int32 i = 0; i < ReadbackLatency + 1; ++i) {
+    Job->SlabSlots.Add(MakeShared<FSlabSlot, ESPMode::ThreadSafe>());
+  }
+
+  try {
+    // Half floats are returned as floats, like FromVolumeTexture does
+    const int sz[3]{Job->Size.Z, Job->Size.Y, Job->Size.X};
+    Job->Result.create(3, sz, Format == PF_R16F ? CV_32FC1 : detail::PixelFormatToCvType(Format));
+    Job->ResultMapped = Job->Result.getMat(cv::ACCESS_WRITE);
+  } catch (cv::Exception& e) {
+    UE_LOG(OpenCV, Warning, TEXT("Function %s: Caught OpenCV Exception: %s"), TEXT(__FUNCTION__),
+           UTF8_TO_TCHAR(e.what()));
+    return false;
+  }
+
+  VolumeJobs.Add(Job);
+  StartTicking();
+  return true;
+}
+
+void FCVTextureReadback::StartTicking() {
+  if (!TickHandle.IsValid()) {
+    TickHandle = FTicker::GetCoreTicker().AddTicker(
+        FTickerDelegate::CreateRaw(this, &FCVTextureReadback::Tick));
+  }
+}
+
+TFuture<cv::UMat> FCVTextureReadback::Enqueue(UTexture* Texture) {
+  auto Promise = MakeShared<TPromise<cv::UMat>, ESPMode::ThreadSafe>();
+  TFuture<cv::UMat> Future = Promise->GetFuture();
+
+  if (!Enqueue(Texture, [Promise](bool bSuccess, cv::UMat Result) {
+        Promise->SetValue(MoveTemp(Result));
+      })) {
+    Promise->SetValue(cv::UMat());
+  }
+  return Future;
+}
+
+bool FCVTextureReadback::Tick(float DeltaTime) {
+  for (const FSlotPtr& Slot : Slots) {
+    // Wait until the copy was submitted and the GPU had a couple of frames to execute it
+    if (Slot->State != FSlot::EState::Copying || !Slot->CopyFence.IsFenceComplete() ||
+        GFrameCounter < Slot->CopyFrame + ReadbackLatency) {
+      continue;
+    }
+
+    Slot->State = FSlot::EState::Mapping;
+
+    ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(MapCVReadbackSlot, FSlotPtr, Slot, Slot, {
+      cv::UMat Result;
+      bool bSuccess = false;
+
+      if (Slot->CvType != -1 && Slot->StagingTexture) {
+        void* Data{nullptr};
+        int32 PitchInPixels{0}, Height{0};
+        RHICmdList.MapStagingSurface(Slot->StagingTexture, Data, PitchInPixels, Height);
+
+        if (Data) {
+          // The staging surface rows are padded, its "width" is the row pitch in pixels
+          cv::Mat Wrapped(Slot->Size.Y, Slot->Size.X, Slot->CvType, Data,
+                          PitchInPixels * CV_ELEM_SIZE(Slot->CvType));
+          Result.create(Slot->Size.Y, Slot->Size.X, Slot->CvType);
+          {
+            cv::Mat Dst = Result.getMat(cv::ACCESS_WRITE);
+            Wrapped.copyTo(Dst);
+          }
+          bSuccess = true;
+        }
+        RHICmdList.UnmapStagingSurface(Slot->StagingTexture);
+      }
+
+      AsyncTask(ENamedThreads::GameThread, [Slot, bSuccess, Result]() {
+        FOnReadbackComplete OnComplete = MoveTemp(Slot->OnComplete);
+        Slot->OnComplete = nullptr;
+        Slot->State = FSlot::EState::Free;
+        if (OnComplete) {
+          OnComplete(bSuccess, Result);
+        }
+      });
+    });
+  }
+
+  // Completion callbacks may enqueue new jobs, so iterate over a copy
+  for (const FVolumeJobPtr& Job : TArray<FVolumeJobPtr>(VolumeJobs)) {
+    if (TickVolumeJob(Job)) {
+      VolumeJobs.Remove(Job);
+      const bool bSuccess = !Job->bFailed;
+      if (Job->OnComplete) {
+        Job->OnComplete(bSuccess, bSuccess ? Job->Result : cv::UMat());
+      }
+    }
+  }
+
+  if (GetNumInFlight() == 0) {
+    TickHandle.Reset();
+    return false;
+  }
+  return true;
+}
+
+bool FCVTextureReadback::TickVolumeJob(const FVolumeJobPtr& Job) {
+  // Map the slabs whose copy has certainly finished on the GPU, like the 2D slots
+  for (const FSlabSlotPtr& Slot : Job->SlabSlots) {
+    if (Slot->State == FSlabSlot::EState::Mapping && Slot->Fence.IsFenceComplete()) {
+      Slot->State = FSlabSlot::EState::Free;
+    }
+    if (Slot->State != FSlabSlot::EState::Copying || !Slot->Fence.IsFenceComplete() ||
+        GFrameCounter < Slot->CopyFrame + ReadbackLatency) {
+      continue;
+    }
+
+    ENQUEUE_UNIQUE_RENDER_COMMAND_TWOPARAMETER(
+        MapCVVolumeSlab, FVolumeJobPtr, Job, Job, FSlabSlotPtr, Slot, Slot, {
+          if (!Slot->StagingTexture) return;
+
+          void* Data{nullptr};
+          int32 PitchInPixels{0}, Height{0};
+          RHICmdList.MapStagingSurface(Slot->StagingTexture, Data, PitchInPixels, Height);
+          if (Data) {
+            // The slices are stacked vertically, and the result is continuous, so the slab is a
+            // single block of rows in both
+            const int32 CvType = detail::PixelFormatToCvType(Job->Format);
+            const int32 Rows = Job->Size.Y * (Slot->Slab.Y - Slot->Slab.X);
+            const cv::Mat Wrapped(Rows, Job->Size.X, CvType, Data,
+                                  PitchInPixels * CV_ELEM_SIZE(CvType));
+            cv::Mat Dst(Rows, Job->Size.X, Job->ResultMapped.type(),
+                        Job->ResultMapped.ptr(Slot->Slab.X));
+            if (Job->Format == PF_R16F) {
+              cv::convertFp16(Wrapped, Dst);
+            } else {
+              Wrapped.copyTo(Dst);
+            }
+          } else {
+            Job->bFailed = true;
+          }
+          RHICmdList.UnmapStagingSurface(Slot->StagingTexture);
+        });
+
+    Slot->State = FSlabSlot::EState::Mapping;
+    Slot->Fence.BeginFence();
+  }
+
+  // Copy the next slab into a free staging texture
+  FSlabSlotPtr* FreeSlot = Job->SlabSlots.FindByPredicate(
+      [](const FSlabSlotPtr& Slot) { return Slot->State == FSlabSlot::EState::Free; });
+  if (Job->NextSlice < Job->Size.Z && FreeSlot) {
+    // The slabs read so far would not match the rest of a recreated or destroyed texture
+    if (!Job->Texture.IsValid() || Job->Texture->Resource != Job->Resource) {
+      UE_LOG(OpenCV, Warning, TEXT("Volume texture changed during the readback, aborting."));
+      Job->bFailed = true;
+      Job->NextSlice = Job->Size.Z;
+    }
+  }
+  if (Job->NextSlice < Job->Size.Z && FreeSlot) {
+    FSlabSlotPtr Slot = *FreeSlot;
+    Slot->Slab = FIntPoint(Job->NextSlice,
+                           FMath::Min(Job->NextSlice + Job->SlicesPerFrame, Job->Size.Z));
+    Job->NextSlice = Slot->Slab.Y;
+
+    // The resource is still alive on the render thread: it is released by a render command that
+    // is enqueued after this one
+    ENQUEUE_UNIQUE_RENDER_COMMAND_THREEPARAMETER(
+        CopyCVVolumeSlab, FVolumeJobPtr, Job, Job, FSlabSlotPtr, Slot, Slot, FTextureResource*,
+        Resource, Job->Texture->Resource, {
+          FTexture3DRHIRef TextureRHI =
+              Resource->TextureRHI ? Resource->TextureRHI->GetTexture3D() : nullptr;
+          if (!TextureRHI) {
+            Job->bFailed = true;
+            Slot->StagingTexture.SafeRelease();
+            return;
+          }
+
+          // Only the last slab can be smaller, so the textures are reused for all others
+          const FIntPoint SlabSize(Job->Size.X, Job->Size.Y * (Slot->Slab.Y - Slot->Slab.X));
+          if (!Slot->SlabTexture || Slot->SlabTexture->GetSizeXY() != SlabSize) {
+            FRHIResourceCreateInfo CreateInfo;
+            Slot->SlabTexture =
+                RHICreateTexture2D(SlabSize.X, SlabSize.Y, Job->Format, 1, 1,
+                                   TexCreate_ShaderResource | TexCreate_UAV, CreateInfo);
+            Slot->SlabUAV = RHICreateUnorderedAccessView(Slot->SlabTexture, 0);
+            Slot->StagingTexture = RHICreateTexture2D(SlabSize.X, SlabSize.Y, Job->Format, 1, 1,
+                                                      TexCreate_CPUReadback, CreateInfo);
+          }
+
+          detail::CopyVolumeSlab(RHICmdList, TextureRHI, Slot->Slab.X,
+                                 Slot->Slab.Y - Slot->Slab.X, Slot->SlabUAV);
+          RHICmdList.CopyToResolveTarget(Slot->SlabTexture, Slot->StagingTexture,
+                                         FResolveParams());
+        });
+
+    Slot->State = FSlabSlot::EState::Copying;
+    Slot->Fence.BeginFence();
+    Slot->CopyFrame = GFrameCounter;
+  }
+
+  // Done once every slab was copied and mapped
+  if (Job->NextSlice < Job->Size.Z) {
+    return false;
+  }
+  for (const FSlabSlotPtr& Slot : Job->SlabSlots) {
+    if (Slot->State != FSlabSlot::EState::Free) return false;
+  }
+
+  Job->ResultMapped.release();
+  return true;
+}
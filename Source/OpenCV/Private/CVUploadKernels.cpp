@@ -0,0 +1,342 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#include "CVUploadKernels.h"
+
+#include "OpenCV_Common.h"
+
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+
+THIRD_PARTY_INCLUDES_START
+#include <opencv2/imgproc.hpp>
+THIRD_PARTY_INCLUDES_END
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define CV_UPLOAD_KERNELS_X86 1
+#include <immintrin.h>
+#else
+#define CV_UPLOAD_KERNELS_X86 0
+#endif
+
+// MSVC allows any intrinsics in any function, GCC/Clang need the target ISA per function
+#if defined(__clang__) || defined(__GNUC__)
+#define CV_UPLOAD_KERNEL_TARGET(Isa) __attribute__((target(Isa)))
+#else
+#define CV_UPLOAD_KERNEL_TARGET(Isa)
+#endif
+
+namespace {
+// Fixed point precision of the interpolation weights (same as cv::resize)
+constexpr int32 CoefBits = 11;
+constexpr int32 CoefScale = 1 << CoefBits;
+
+// Number of destination rows processed by one parallel task
+constexpr int32 RowsPerStripe = 16;
+
+// Source positions and weights for bilinear interpolation along one axis, using the same pixel
+// center convention as cv::resize with INTER_LINEAR
+struct FInterpolationTable {
+  TArray<int32> Index0;
+  TArray<int32> Index1;
+  TArray<int32> Weight1;
+
+  FInterpolationTable(int32 SrcSize, int32 DstSize, int32 IndexScale) {
+    Index0.SetNumUninitialized(DstSize);
+    Index1.SetNumUninitialized(DstSize);
+    Weight1.SetNumUninitialized(DstSize);
+
+    const double Scale = static_cast<double>(SrcSize) / DstSize;
+    for (int32 i = 0; i < DstSize; ++i) {
+      const double Pos = (i + 0.5) * Scale - 0.5;
+      int32 I0 = FMath::FloorToInt(Pos);
+      double Frac = Pos - I0;
+      if (I0 < 0) {
+        I0 = 0;
+        Frac = 0;
+      } else if (I0 >= SrcSize - 1) {
+        I0 = SrcSize - 1;
+        Frac = 0;
+      }
+      Index0[i] = I0 * IndexScale;
+      Index1[i] = FMath::Min(I0 + 1, SrcSize - 1) * IndexScale;
+      Weight1[i] = static_cast<int32>(Frac * CoefScale + 0.5);
+    }
+  }
+};
+
+template <int32 SrcChannels>
+void ResizeRowsToBGRA(const cv::Mat& Src, cv::Mat& Dst, int32 RowBegin, int32 RowEnd,
+                      const FInterpolationTable& X, const FInterpolationTable& Y) {
+  constexpr int32 Round = 1 << (2 * CoefBits - 1);
+
+  for (int32 y = RowBegin; y < RowEnd; ++y) {
+    const uint8* Row0 = Src.ptr<uint8>(Y.Index0[y]);
+    const uint8* Row1 = Src.ptr<uint8>(Y.Index1[y]);
+    const int32 WY1 = Y.Weight1[y];
+    const int32 WY0 = CoefScale - WY1;
+    uint8* Out = Dst.ptr<uint8>(y);
+
+    for (int32 x = 0; x < Dst.cols; ++x, Out += 4) {
+      const int32 A = X.Index0[x];
+      const int32 B = X.Index1[x];
+      const int32 WX1 = X.Weight1[x];
+      const int32 WX0 = CoefScale - WX1;
+
+      uint8 Pixel[4];
+      for (int32 c = 0; c < SrcChannels; ++c) {
+        const int32 Top = Row0[A + c] * WX0 + Row0[B + c] * WX1;
+        const int32 Bottom = Row1[A + c] * WX0 + Row1[B + c] * WX1;
+        Pixel[c] = static_cast<uint8>((Top * WY0 + Bottom * WY1 + Round) >> (2 * CoefBits));
+      }
+
+      if (SrcChannels == 1) {
+        Out[0] = Out[1] = Out[2] = Pixel[0];
+        Out[3] = 0xFF;
+      } else {
+        Out[0] = Pixel[0];
+        Out[1] = Pixel[1];
+        Out[2] = Pixel[2];
+        Out[3] = SrcChannels == 4 ? Pixel[3] : 0xFF;
+      }
+    }
+  }
+}
+
+template <int32 SrcChannels> void ResizeToBGRA(const cv::Mat& Src, cv::Mat& Dst) {
+  const FInterpolationTable X(Src.cols, Dst.cols, SrcChannels);
+  const FInterpolationTable Y(Src.rows, Dst.rows, 1);
+
+  const int32 NumStripes = (Dst.rows + RowsPerStripe - 1) / RowsPerStripe;
+  ParallelFor(NumStripes, [&](int32 Stripe) {
+    const int32 RowBegin = Stripe * RowsPerStripe;
+    const int32 RowEnd = FMath::Min(RowBegin + RowsPerStripe, Dst.rows);
+    ResizeRowsToBGRA<SrcChannels>(Src, Dst, RowBegin, RowEnd, X, Y);
+  });
+}
+
+//
+// Row kernels for the conversion to BGRA. All of them process Width pixels of one row and set
+// alpha to 0xFF. The vector loops stop early enough to never read past the end of the row, the
+// remaining pixels are handled by the scalar versions.
+//
+using FRowKernel = void (*)(const uint8* Src, uint8* Dst, int32 Width);
+
+struct FBGRAKernels {
+  const TCHAR* Name;
+  FRowKernel BGRToBGRA;
+  FRowKernel GrayToBGRA;
+};
+
+void BGRToBGRA_Scalar(const uint8* Src, uint8* Dst, int32 Width) {
+  for (int32 x = 0; x < Width; ++x, Src += 3, Dst += 4) {
+    Dst[0] = Src[0];
+    Dst[1] = Src[1];
+    Dst[2] = Src[2];
+    Dst[3] = 0xFF;
+  }
+}
+
+void GrayToBGRA_Scalar(const uint8* Src, uint8* Dst, int32 Width) {
+  for (int32 x = 0; x < Width; ++x, Dst += 4) {
+    Dst[0] = Dst[1] = Dst[2] = Src[x];
+    Dst[3] = 0xFF;
+  }
+}
+
+const FBGRAKernels ScalarKernels{TEXT("Scalar"), &BGRToBGRA_Scalar, &GrayToBGRA_Scalar};
+
+#if CV_UPLOAD_KERNELS_X86
+CV_UPLOAD_KERNEL_TARGET("sse4.1")
+void BGRToBGRA_SSE41(const uint8* Src, uint8* Dst, int32 Width) {
+  const __m128i Shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i Alpha = _mm_set1_epi32(static_cast<int32>(0xFF000000));
+
+  // 4 pixels per iteration, reading 16 of which 12 bytes are used
+  int32 x = 0;
+  for (; x + 6 <= Width; x += 4) {
+    const __m128i BGR = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Src + 3 * x));
+    const __m128i BGRA = _mm_or_si128(_mm_shuffle_epi8(BGR, Shuffle), Alpha);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(Dst + 4 * x), BGRA);
+  }
+  BGRToBGRA_Scalar(Src + 3 * x, Dst + 4 * x, Width - x);
+}
+
+CV_UPLOAD_KERNEL_TARGET("sse4.1")
+void GrayToBGRA_SSE41(const uint8* Src, uint8* Dst, int32 Width) {
+  const __m128i Ones = _mm_set1_epi8(-1);
+
+  // 16 pixels per iteration: interleave (g, g) and (g, 0xFF) byte pairs to g g g 0xFF
+  int32 x = 0;
+  for (; x + 16 <= Width; x += 16) {
+    const __m128i G = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Src + x));
+    const __m128i GGLo = _mm_unpacklo_epi8(G, G);
+    const __m128i GGHi = _mm_unpackhi_epi8(G, G);
+    const __m128i GALo = _mm_unpacklo_epi8(G, Ones);
+    const __m128i GAHi = _mm_unpackhi_epi8(G, Ones);
+
+    __m128i* Out = reinterpret_cast<__m128i*>(Dst + 4 * x);
+    _mm_storeu_si128(Out + 0, _mm_unpacklo_epi16(GGLo, GALo));
+    _mm_storeu_si128(Out + 1, _mm_unpackhi_epi16(GGLo, GALo));
+    _mm_storeu_si128(Out + 2, _mm_unpacklo_epi16(GGHi, GAHi));
+    _mm_storeu_si128(Out + 3, _mm_unpackhi_epi16(GGHi, GAHi));
+  }
+  GrayToBGRA_Scalar(Src + x, Dst + 4 * x, Width - x);
+}
+
+CV_UPLOAD_KERNEL_TARGET("avx2")
+void BGRToBGRA_AVX2(const uint8* Src, uint8* Dst, int32 Width) {
+  const __m256i Shuffle =
+      _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,  // low lane
+                       0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);  // high lane
+  const __m256i Alpha = _mm256_set1_epi32(static_cast<int32>(0xFF000000));
+
+  // 8 pixels per iteration, each lane gets 4 pixels (the shuffle cannot cross lanes)
+  int32 x = 0;
+  for (; x + 10 <= Width; x += 8) {
+    const __m128i Lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Src + 3 * x));
+    const __m128i Hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Src + 3 * x + 12));
+    const __m256i BGR = _mm256_inserti128_si256(_mm256_castsi128_si256(Lo), Hi, 1);
+    const __m256i BGRA = _mm256_or_si256(_mm256_shuffle_epi8(BGR, Shuffle), Alpha);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(Dst + 4 * x), BGRA);
+  }
+  BGRToBGRA_Scalar(Src + 3 * x, Dst + 4 * x, Width - x);
+}
+
+CV_UPLOAD_KERNEL_TARGET("avx2")
+void GrayToBGRA_AVX2(const uint8* Src, uint8* Dst, int32 Width) {
+  const __m256i Splat = _mm256_set1_epi32(0x00010101);
+  const __m256i Alpha = _mm256_set1_epi32(static_cast<int32>(0xFF000000));
+
+  // 8 pixels per iteration: widen to 32 bit and replicate g into the three color bytes
+  int32 x = 0;
+  for (; x + 8 <= Width; x += 8) {
+    const __m128i G = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(Src + x));
+    const __m256i G32 = _mm256_cvtepu8_epi32(G);
+    const __m256i BGRA = _mm256_or_si256(_mm256_mullo_epi32(G32, Splat), Alpha);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(Dst + 4 * x), BGRA);
+  }
+  GrayToBGRA_Scalar(Src + x, Dst + 4 * x, Width - x);
+}
+
+const FBGRAKernels SSE41Kernels{TEXT("SSE4.1"), &BGRToBGRA_SSE41, &GrayToBGRA_SSE41};
+const FBGRAKernels AVX2Kernels{TEXT("AVX2"), &BGRToBGRA_AVX2, &GrayToBGRA_AVX2};
+#endif
+
+// All kernel sets the current CPU supports, best first
+TArray<const FBGRAKernels*> GetSupportedKernels() {
+  TArray<const FBGRAKernels*> Kernels;
+#if CV_UPLOAD_KERNELS_X86
+  if (cv::checkHardwareSupport(CV_CPU_AVX2)) Kernels.Add(&AVX2Kernels);
+  if (cv::checkHardwareSupport(CV_CPU_SSE4_1)) Kernels.Add(&SSE41Kernels);
+#endif
+  Kernels.Add(&ScalarKernels);
+  return Kernels;
+}
+
+const FBGRAKernels& GetBestKernels() {
+  static const FBGRAKernels* Best = GetSupportedKernels()[0];
+  return *Best;
+}
+
+bool ConvertToBGRAWithKernels(const cv::Mat& Src, cv::Mat& Dst, const FBGRAKernels& Kernels) {
+  if (Dst.type() != CV_8UC4 || Src.size() != Dst.size()) return false;
+
+  FRowKernel RowKernel = nullptr;
+  switch (Src.type()) {
+    case CV_8UC1: RowKernel = Kernels.GrayToBGRA; break;
+    case CV_8UC3: RowKernel = Kernels.BGRToBGRA; break;
+    default: return false;
+  }
+
+  const int32 NumStripes = (Dst.rows + RowsPerStripe - 1) / RowsPerStripe;
+  ParallelFor(NumStripes, [&](int32 Stripe) {
+    const int32 RowBegin = Stripe * RowsPerStripe;
+    const int32 RowEnd = FMath::Min(RowBegin + RowsPerStripe, Dst.rows);
+    for (int32 y = RowBegin; y < RowEnd; ++y) {
+      RowKernel(Src.ptr<uint8>(y), Dst.ptr<uint8>(y), Dst.cols);
+    }
+  });
+  return true;
+}
+
+// Times the upload conversions against cv::cvtColor and checks that the results match
+void BenchmarkUploadKernels() {
+  constexpr int32 NumIterations = 20;
+  const struct {
+    const TCHAR* Name;
+    cv::Size Size;
+  } Resolutions[] = {{TEXT("720p"), {1280, 720}}, {TEXT("1080p"), {1920, 1080}},
+                     {TEXT("4K"), {3840, 2160}}};
+  const struct {
+    const TCHAR* Name;
+    int32 SrcType;
+    int32 Conversion;
+  } Conversions[] = {{TEXT("BGR->BGRA"), CV_8UC3, cv::COLOR_BGR2BGRA},
+                     {TEXT("GRAY->BGRA"), CV_8UC1, cv::COLOR_GRAY2BGRA}};
+
+  for (const auto& Resolution : Resolutions) {
+    for (const auto& Conversion : Conversions) {
+      cv::Mat Src(Resolution.Size, Conversion.SrcType);
+      cv::randu(Src, cv::Scalar::all(0), cv::Scalar::all(255));
+      cv::Mat Reference(Resolution.Size, CV_8UC4);
+      cv::Mat Result(Resolution.Size, CV_8UC4);
+
+      double Start = FPlatformTime::Seconds();
+      for (int32 i = 0; i < NumIterations; ++i) {
+        cv::cvtColor(Src, Reference, Conversion.Conversion);
+      }
+      const double CvtColorMs = (FPlatformTime::Seconds() - Start) * 1000.0 / NumIterations;
+      UE_LOG(OpenCV, Display, TEXT("%-6s %-11s cv::cvtColor %7.3f ms"), Resolution.Name,
+             Conversion.Name, CvtColorMs);
+
+      for (const FBGRAKernels* Kernels : GetSupportedKernels()) {
+        Start = FPlatformTime::Seconds();
+        for (int32 i = 0; i < NumIterations; ++i) {
+          ConvertToBGRAWithKernels(Src, Result, *Kernels);
+        }
+        const double KernelMs = (FPlatformTime::Seconds() - Start) * 1000.0 / NumIterations;
+        const bool bMatches = cv::norm(Reference, Result, cv::NORM_INF) == 0;
+        UE_LOG(OpenCV, Display, TEXT("%-6s %-11s %-12s %7.3f ms (%.2fx)%s"), Resolution.Name,
+               Conversion.Name, Kernels->Name, KernelMs, CvtColorMs / KernelMs,
+               bMatches ? TEXT("") : TEXT(" MISMATCH!"));
+      }
+    }
+  }
+}
+
+FAutoConsoleCommand BenchmarkUploadKernelsCommand(
+    TEXT("OpenCV.BenchmarkUploadKernels"),
+    TEXT("Benchmarks the BGR/GRAY->BGRA upload conversion kernels against cv::cvtColor at 720p, ")
+        TEXT("1080p and 4K and logs the results."),
+    FConsoleCommandDelegate::CreateStatic(&BenchmarkUploadKernels));
+}  // namespace
+
+namespace detail {
+
+void ResizeAndConvert(const cv::Mat& Src, cv::Mat& Dst, int Conversion) {
+  if (Dst.type() == CV_8UC4 && Src.depth() == CV_8U) {
+    switch (Src.channels()) {
+      case 1: ResizeToBGRA<1>(Src, Dst); return;
+      case 3: ResizeToBGRA<3>(Src, Dst); return;
+      case 4: ResizeToBGRA<4>(Src, Dst); return;
+      default: break;
+    }
+  }
+
+  // Generic fallback, cv::resize is parallel already but needs a temporary for the conversion
+  if (Conversion == -1) {
+    cv::resize(Src, Dst, Dst.size());
+  } else {
+    cv::Mat Resized;
+    cv::resize(Src, Resized, Dst.size());
+    cv::cvtColor(Resized, Dst, Conversion);
+  }
+}
+
+bool ConvertToBGRA(const cv::Mat& Src, cv::Mat& Dst) {
+  return ConvertToBGRAWithKernels(Src, Dst, GetBestKernels());
+}
+
+}  // namespace detail
@@ -0,0 +1,25 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+THIRD_PARTY_INCLUDES_START
+#include <opencv2/core.hpp>
+THIRD_PARTY_INCLUDES_END
+
+namespace detail {
+
+// Resizes Src to the size of Dst and converts it to the layout of Dst (Conversion is the
+// cv::cvtColor code, or -1 if Src and Dst have the same type). Src is left untouched.
+// 8-bit gray/BGR/BGRA to BGRA is done in a single bilinear pass that runs in parallel over row
+// stripes, all other combinations fall back to OpenCV.
+void ResizeAndConvert(const cv::Mat& Src, cv::Mat& Dst, int Conversion);
+
+// Converts an 8-bit gray or BGR Src to a BGRA Dst of the same size with constant 0xFF alpha.
+// Uses dedicated AVX2/SSE4.1 kernels selected at runtime and runs in parallel over row stripes.
+// Returns false (and does nothing) for other source types.
+bool ConvertToBGRA(const cv::Mat& Src, cv::Mat& Dst);
+
+}  // namespace detail
@@ -0,0 +1,137 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#include "CVVideoIndex.h"
+
+#include "OpenCV_Common.h"
+
+#include "Algo/BinarySearch.h"
+#include "HAL/FileManager.h"
+#include "Serialization/Archive.h"
+#include "Templates/UniquePtr.h"
+
+THIRD_PARTY_INCLUDES_START
+#include <opencv2/videoio.hpp>
+THIRD_PARTY_INCLUDES_END
+
+namespace {
+constexpr uint32 IndexMagic = 0x58495643;  // "CVIX"
+constexpr uint32 IndexVersion = 1;
+
+bool GetFileStamp(const FString& VideoFile, int64& OutSize, FDateTime& OutTime) {
+  IFileManager& FileManager = IFileManager::Get();
+  OutSize = FileManager.FileSize(*VideoFile);
+  OutTime = FileManager.GetTimeStamp(*VideoFile);
+  return OutSize >= 0;
+}
+}  // namespace
+
+namespace detail {
+
+int64 FCVVideoIndex::FindFrame(double Time) const {
+  if (FrameTimes.Num() == 0) return 0;
+  const int32 Next = Algo::UpperBound(FrameTimes, Time);
+  return FMath::Max(Next - 1, 0);
+}
+
+FString GetVideoIndexFile(const FString& VideoFile) { return VideoFile + TEXT(".cvindex"); }
+
+bool LoadVideoIndex(const FString& VideoFile, FCVVideoIndex& OutIndex) {
+  TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*GetVideoIndexFile(VideoFile)));
+  if (!Reader) return false;
+
+  uint32 Magic = 0, Version = 0;
+  *Reader << Magic << Version;
+  if (Magic != IndexMagic || Version != IndexVersion) return false;
+
+  *Reader << OutIndex.FileSize << OutIndex.FileTime << OutIndex.FPS << OutIndex.FrameTimes;
+  if (Reader->IsError()) return false;
+
+  int64 FileSize;
+  FDateTime FileTime;
+  return GetFileStamp(VideoFile, FileSize, FileTime) && FileSize == OutIndex.FileSize &&
+         FileTime == OutIndex.FileTime;
+}
+
+bool SaveVideoIndex(const FString& VideoFile, const FCVVideoIndex& Index) {
+  const FString IndexFile = GetVideoIndexFile(VideoFile);
+  TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*IndexFile));
+  if (!Writer) {
+    UE_LOG(OpenCV, Warning, TEXT("Could not write the video index %s"), *IndexFile);
+    return false;
+  }
+
+  uint32 Magic = IndexMagic, Version = IndexVersion;
+  FCVVideoIndex Copy = Index;
+  *Writer << Magic << Version;
+  *Writer << Copy.FileSize << Copy.FileTime << Copy.FPS << Copy.FrameTimes;
+  return Writer->Close();
+}
+
+bool BuildVideoIndex(const FString& VideoFile, const FThreadSafeBool& bCancel,
+                     FCVVideoIndex& OutIndex) {
+  if (!GetFileStamp(VideoFile, OutIndex.FileSize, OutIndex.FileTime)) return false;
+
+  try {
+    cv::VideoCapture Capture(std::string(TCHAR_TO_UTF8(*VideoFile)));
+    if (!Capture.isOpened()) return false;
+
+    OutIndex.FPS = Capture.get(cv::CAP_PROP_FPS);
+    const double FrameDuration = OutIndex.FPS > 0 ? 1.0 / OutIndex.FPS : 0.0;
+    OutIndex.FrameTimes.Reset();
+    OutIndex.FrameTimes.Reserve(FMath::Max(int32(Capture.get(cv::CAP_PROP_FRAME_COUNT)), 0));
+
+    // grab() demuxes (and for most backends decodes) but never converts the frames
+    while (!bCancel && Capture.grab()) {
+      // Fall back to the frame rate if the backend does not report increasing timestamps
+      const double Time = Capture.get(cv::CAP_PROP_POS_MSEC) / 1000.0;
+      const int32 Num = OutIndex.FrameTimes.Num();
+      OutIndex.FrameTimes.Add(Num == 0 || Time > OutIndex.FrameTimes.Last()
+                                  ? Time
+                                  : OutIndex.FrameTimes.Last() + FrameDuration);
+    }
+  } catch (cv::Exception& e) {
+    UE_LOG(OpenCV, Warning, TEXT("Function %s: Caught OpenCV Exception: %s"), TEXT(__FUNCTION__),
+           UTF8_TO_TCHAR(e.what()));
+    return false;
+  }
+  return !bCancel && OutIndex.FrameTimes.Num() > 0;
+}
+
+bool FCVFrameCache::Find(int64 Frame, cv::UMat& OutImage) {
+  for (FEntry& Entry : Entries) {
+    if (Entry.Frame == Frame) {
+      Entry.LastUse = ++UseCounter;
+      OutImage = Entry.Image;
+      return true;
+    }
+  }
+  return false;
+}
+
+void FCVFrameCache::Add(int64 Frame, const cv::UMat& Image) {
+  if (Capacity <= 0) return;
+
+  FEntry* Target = nullptr;
+  for (FEntry& Entry : Entries) {
+    if (Entry.Frame == Frame) {
+      Target = &Entry;
+      break;
+    }
+  }
+  if (!Target && Entries.Num() < Capacity) {
+    Target = &Entries[Entries.AddDefaulted()];
+  }
+  if (!Target) {
+    Target = &Entries[0];
+    for (FEntry& Entry : Entries) {
+      if (Entry.LastUse < Target->LastUse) Target = &Entry;
+    }
+  }
+
+  Target->Frame = Frame;
+  Target->Image = Image;
+  Target->LastUse = ++UseCounter;
+}
+
+}  // namespace detail
@@ -0,0 +1,73 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+
+THIRD_PARTY_INCLUDES_START
+#include <opencv2/core.hpp>
+THIRD_PARTY_INCLUDES_END
+
+namespace detail {
+
+// Presentation time of every frame of a video file
+struct FCVVideoIndex {
+  // Size and modification time of the indexed file, to tell whether a cached index is stale
+  int64 FileSize = 0;
+  FDateTime FileTime;
+  double FPS = 0.0;
+  // Time of each frame in seconds, in decoding order
+  TArray<double> FrameTimes;
+
+  int64 Num() const { return FrameTimes.Num(); }
+
+  double GetFrameTime(int64 Frame) const { return FrameTimes[static_cast<int32>(Frame)]; }
+
+  // The frame that is shown at Time, i.e. the last frame starting at or before Time
+  int64 FindFrame(double Time) const;
+};
+
+// Where the index of VideoFile is cached, next to the video
+FString GetVideoIndexFile(const FString& VideoFile);
+
+// Loads the cached index of VideoFile, returns false if there is none or it is out of date
+bool LoadVideoIndex(const FString& VideoFile, FCVVideoIndex& OutIndex);
+
+// Writes the index of VideoFile next to the video
+bool SaveVideoIndex(const FString& VideoFile, const FCVVideoIndex& Index);
+
+// Reads through the whole file with a separate capture and records the time of every frame.
+// Returns false if the file could not be read or bCancel was set.
+bool BuildVideoIndex(const FString& VideoFile, const FThreadSafeBool& bCancel,
+                     FCVVideoIndex& OutIndex);
+
+// A small cache of decoded frames that evicts the least recently used frame
+class FCVFrameCache {
+public:
+  explicit FCVFrameCache(int32 InCapacity) : Capacity(InCapacity), UseCounter(0) {}
+
+  // Looks up a frame and marks it as used, returns false if it is not cached
+  bool Find(int64 Frame, cv::UMat& OutImage);
+
+  // Adds a frame, evicting the least recently used one if the cache is full. The image is shared,
+  // not copied, so it must not be written to afterwards.
+  void Add(int64 Frame, const cv::UMat& Image);
+
+  void Reset() { Entries.Reset(); }
+
+private:
+  struct FEntry {
+    int64 Frame = -1;
+    cv::UMat Image;
+    uint64 LastUse = 0;
+  };
+
+  // Caches hold a few dozen frames at most, so a linear search beats any bookkeeping
+  TArray<FEntry> Entries;
+  int32 Capacity;
+  uint64 UseCounter;
+};
+
+}  // namespace detail
@@ -0,0 +1,194 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#include "CVVolumeFile.h"
+
+#include "OpenCV_Common.h"
+
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/Paths.h"
+
+namespace {
+// Keeps a file mapping alive for as long as a matrix references it
+struct FMappedVolume {
+  TUniquePtr<IMappedFileHandle> Handle;
+  TUniquePtr<IMappedFileRegion> Region;
+};
+
+// Allocator of matrices that wrap a mapped file. The mapping is stored in UMatData::userdata and
+// released together with it. New allocations (e.g. if such a matrix is re-created) go to the
+// default allocator.
+class FMappedFileAllocator : public cv::MatAllocator {
+public:
+  cv::UMatData* allocate(int Dims, const int* Sizes, int Type, void* Data, size_t* Step, int Flags,
+                         cv::UMatUsageFlags UsageFlags) const override {
+    return cv::Mat::getStdAllocator()->allocate(Dims, Sizes, Type, Data, Step, Flags, UsageFlags);
+  }
+
+  bool allocate(cv::UMatData* Data, int AccessFlags, cv::UMatUsageFlags UsageFlags) const override {
+    return cv::Mat::getStdAllocator()->allocate(Data, AccessFlags, UsageFlags);
+  }
+
+  void deallocate(cv::UMatData* Data) const override {
+    if (!Data) return;
+    CV_Assert(Data->urefcount == 0 && Data->refcount == 0);
+    delete static_cast<FMappedVolume*>(Data->userdata);
+    Data->userdata = nullptr;
+    delete Data;
+  }
+
+  static FMappedFileAllocator& Get() {
+    static FMappedFileAllocator Instance;
+    return Instance;
+  }
+};
+
+int32 MetaElementTypeToCvDepth(const FString& ElementType) {
+  if (ElementType == TEXT("MET_UCHAR")) return CV_8U;
+  if (ElementType == TEXT("MET_CHAR")) return CV_8S;
+  if (ElementType == TEXT("MET_USHORT")) return CV_16U;
+  if (ElementType == TEXT("MET_SHORT")) return CV_16S;
+  if (ElementType == TEXT("MET_INT")) return CV_32S;
+  if (ElementType == TEXT("MET_FLOAT")) return CV_32F;
+  if (ElementType == TEXT("MET_DOUBLE")) return CV_64F;
+  return -1;
+}
+
+// Upper bound of the header size, so .mha files are not read completely
+constexpr int64 MaxHeaderSize = 64 * 1024;
+}  // namespace
+
+namespace detail {
+
+bool ReadMetaImageHeader(const FString& FileName, FCVVolumeFileLayout& OutLayout) {
+  IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+  TUniquePtr<IFileHandle> File(PlatformFile.OpenRead(*FileName));
+  if (!File) {
+    UE_LOG(OpenCV, Error, TEXT("Could not open %s!"), *FileName);
+    return false;
+  }
+
+  TArray<uint8> Header;
+  Header.SetNumUninitialized(FMath::Min(File->Size(), MaxHeaderSize));
+  if (!File->Read(Header.GetData(), Header.Num())) {
+    UE_LOG(OpenCV, Error, TEXT("Could not read %s!"), *FileName);
+    return false;
+  }
+
+  OutLayout = FCVVolumeFileLayout();
+  int32 Depth = -1;
+  int32 Channels = 1;
+  int32 NumDims = 0;
+  int64 HeaderSize = 0;
+
+  // The header is a list of "Key = Value" lines, ElementDataFile is always the last one
+  int64 LineStart = 0;
+  bool bFoundDataFile = false;
+  while (!bFoundDataFile && LineStart < Header.Num()) {
+    int64 LineEnd = LineStart;
+    while (LineEnd < Header.Num() && Header[LineEnd] != '\n') ++LineEnd;
+
+    const FString Line = FString(static_cast<int32>(LineEnd - LineStart),
+                                 reinterpret_cast<const ANSICHAR*>(&Header[LineStart]))
+                             .TrimStartAndEnd();
+    LineStart = LineEnd + 1;
+
+    FString Key, Value;
+    if (!Line.Split(TEXT("="), &Key, &Value)) continue;
+    Key.TrimStartAndEndInline();
+    Value.TrimStartAndEndInline();
+
+    TArray<FString> Values;
+    Value.ParseIntoArrayWS(Values);
+
+    if (Key == TEXT("NDims")) {
+      NumDims = FCString::Atoi(*Value);
+    } else if (Key == TEXT("DimSize") && Values.Num() == 3) {
+      OutLayout.Dimensions = FIntVector(FCString::Atoi(*Values[0]), FCString::Atoi(*Values[1]),
+                                        FCString::Atoi(*Values[2]));
+    } else if (Key == TEXT("ElementSpacing") && Values.Num() == 3) {
+      OutLayout.Spacing = FVector(FCString::Atof(*Values[0]), FCString::Atof(*Values[1]),
+                                  FCString::Atof(*Values[2]));
+    } else if (Key == TEXT("ElementType")) {
+      Depth = MetaElementTypeToCvDepth(Value);
+    } else if (Key == TEXT("ElementNumberOfChannels")) {
+      Channels = FCString::Atoi(*Value);
+    } else if (Key == TEXT("HeaderSize")) {
+      HeaderSize = FCString::Atoi64(*Value);
+    } else if ((Key == TEXT("BinaryDataByteOrderMSB") || Key == TEXT("ElementByteOrderMSB")) &&
+               Value.ToBool()) {
+      UE_LOG(OpenCV, Error, TEXT("%s: Big endian data is not supported!"), *FileName);
+      return false;
+    } else if (Key == TEXT("CompressedData") && Value.ToBool()) {
+      UE_LOG(OpenCV, Error, TEXT("%s: Compressed data is not supported!"), *FileName);
+      return false;
+    } else if (Key == TEXT("ElementDataFile")) {
+      bFoundDataFile = true;
+      if (Value == TEXT("LOCAL")) {
+        OutLayout.DataFile = FileName;
+        OutLayout.DataOffset = LineStart;
+      } else {
+        OutLayout.DataFile = FPaths::Combine(FPaths::GetPath(FileName), Value);
+        OutLayout.DataOffset = HeaderSize;
+      }
+    }
+  }
+
+  if (!bFoundDataFile || NumDims != 3 || Depth == -1 || Channels < 1 ||
+      Channels > CV_CN_MAX || OutLayout.Dimensions.GetMin() <= 0) {
+    UE_LOG(OpenCV, Error, TEXT("%s is not a supported MetaImage volume!"), *FileName);
+    return false;
+  }
+
+  OutLayout.CvType = CV_MAKETYPE(Depth, Channels);
+  return true;
+}
+
+bool MapVolumeFile(const FCVVolumeFileLayout& Layout, cv::Mat& OutVolume) {
+  const int sz[3]{Layout.Dimensions.Z, Layout.Dimensions.Y, Layout.Dimensions.X};
+  const int64 DataSize = static_cast<int64>(sz[0]) * sz[1] * sz[2] * CV_ELEM_SIZE(Layout.CvType);
+
+  IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+  const int64 FileSize = PlatformFile.FileSize(*Layout.DataFile);
+  const int64 Offset = Layout.DataOffset < 0 ? FileSize - DataSize : Layout.DataOffset;
+  if (FileSize < 0 || Offset < 0 || Offset + DataSize > FileSize) {
+    UE_LOG(OpenCV, Error, TEXT("%s does not contain %lld bytes of voxel data at offset %lld!"),
+           *Layout.DataFile, DataSize, Offset);
+    return false;
+  }
+
+  TUniquePtr<IMappedFileHandle> Handle(PlatformFile.OpenMapped(*Layout.DataFile));
+  TUniquePtr<IMappedFileRegion> Region(Handle ? Handle->MapRegion(Offset, DataSize) : nullptr);
+
+  if (Region) {
+    auto* Mapping = new FMappedVolume{MoveTemp(Handle), MoveTemp(Region)};
+    void* Data = const_cast<uint8*>(Mapping->Region->GetMappedPtr());
+
+    FMappedFileAllocator& Allocator = FMappedFileAllocator::Get();
+    cv::UMatData* MatData = new cv::UMatData(&Allocator);
+    MatData->data = MatData->origdata = static_cast<uchar*>(Data);
+    MatData->size = static_cast<size_t>(DataSize);
+    MatData->userdata = Mapping;
+    MatData->refcount = 1;
+
+    // The matrix takes over the reference, the mapping goes away with the last user of it
+    OutVolume = cv::Mat(3, sz, Layout.CvType, Data);
+    OutVolume.allocator = &Allocator;
+    OutVolume.u = MatData;
+    return true;
+  }
+
+  // No mapped file support on this platform, read the data instead
+  UE_LOG(OpenCV, Log, TEXT("Could not map %s, reading it into memory."), *Layout.DataFile);
+  TUniquePtr<IFileHandle> File(PlatformFile.OpenRead(*Layout.DataFile));
+  OutVolume.create(3, sz, Layout.CvType);
+  if (!File || !File->Seek(Offset) || !File->Read(OutVolume.data, DataSize)) {
+    UE_LOG(OpenCV, Error, TEXT("Could not read %s!"), *Layout.DataFile);
+    OutVolume.release();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace detail
@@ -0,0 +1,33 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+THIRD_PARTY_INCLUDES_START
+#include <opencv2/core.hpp>
+THIRD_PARTY_INCLUDES_END
+
+namespace detail {
+
+// Layout of the voxel data of a volume file
+struct FCVVolumeFileLayout {
+  FString DataFile;
+  // Byte offset of the first voxel in DataFile, -1 to take the data from the end of the file
+  int64 DataOffset = 0;
+  FIntVector Dimensions{0, 0, 0};
+  int32 CvType = -1;
+  FVector Spacing{1.f, 1.f, 1.f};
+};
+
+// Parses a MetaImage header (.mhd with a separate data file or .mha with the data appended).
+// Only uncompressed 3D volumes in little endian byte order are supported.
+bool ReadMetaImageHeader(const FString& FileName, FCVVolumeFileLayout& OutLayout);
+
+// Wraps the voxels described by Layout as a (Z, Y, X) matrix. The file is memory mapped where the
+// platform supports it, the mapping is owned by the matrix and released with its last reference.
+// Otherwise the data is read into memory. Mapped matrices are read-only!
+bool MapVolumeFile(const FCVVolumeFileLayout& Layout, cv::Mat& OutVolume);
+
+}  // namespace detail
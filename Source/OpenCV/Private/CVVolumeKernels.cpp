@@ -0,0 +1,127 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#include "CVVolumeKernels.h"
+
+#include "Async/ParallelFor.h"
+
+THIRD_PARTY_INCLUDES_START
+#include <opencv2/imgproc.hpp>
+THIRD_PARTY_INCLUDES_END
+
+namespace {
+// Number of destination slices downsampled by one parallel task. Source slices shared by
+// neighbouring destination slices are only filtered once within a slab.
+constexpr int32 SlicesPerSlab = 8;
+
+// Z filter taps relative to the first source slice (2 * z) and their weights
+constexpr int32 BoxTaps[]{0, 1};
+constexpr float BoxWeights[]{0.5f, 0.5f};
+constexpr int32 GaussTaps[]{-2, -1, 0, 1, 2};
+constexpr float GaussWeights[]{1 / 16.f, 4 / 16.f, 6 / 16.f, 4 / 16.f, 1 / 16.f};
+
+// Mirrors Z at the volume borders without repeating the border slice (like cv::BORDER_REFLECT_101)
+int32 ReflectSlice(int32 Z, int32 NumSlices) {
+  if (NumSlices == 1) return 0;
+  while (Z < 0 || Z >= NumSlices) {
+    Z = Z < 0 ? -Z : 2 * (NumSlices - 1) - Z;
+  }
+  return Z;
+}
+
+// Filters and decimates one source slice in X and Y, returning it as 32-bit float
+cv::Mat ReduceSlice(const cv::Mat& Slice, const cv::Size& DstSize, bool bGaussian,
+                    bool bHalfFloat) {
+  cv::Mat Src = Slice;
+  if (bHalfFloat) {
+    cv::convertFp16(Slice, Src);
+  }
+
+  cv::Mat Reduced;
+  // pyrDown needs at least two pixels in each direction, the last mips are averaged instead
+  if (bGaussian && Src.cols > 1 && Src.rows > 1) {
+    cv::pyrDown(Src, Reduced, DstSize, cv::BORDER_REFLECT_101);
+  } else {
+    // INTER_AREA is an exact 2x2 box average for even sizes
+    cv::resize(Src, Reduced, DstSize, 0, 0, cv::INTER_AREA);
+  }
+
+  if (Reduced.depth() != CV_32F) {
+    Reduced.convertTo(Reduced, CV_32F);
+  }
+  return Reduced;
+}
+}  // namespace
+
+namespace detail {
+
+void WindowLevelToU8(const cv::Mat& Src, cv::Mat& Dst, float Center, float Width) {
+  check(Src.dims == 3 && Dst.dims == 3 && Src.channels() == 1 && Dst.type() == CV_8UC1);
+  check(Src.size == Dst.size);
+
+  const double Alpha = 255.0 / FMath::Max(Width, SMALL_NUMBER);
+  const double Beta = -(Center - 0.5 * Width) * Alpha;
+
+  // convertTo does the scaling and saturation with SIMD, one slice per task
+  ParallelFor(Src.size[0], [&](int32 Z) {
+    cv::Mat DstSlice = GetSlice(Dst, Z);
+    GetSlice(Src, Z).convertTo(DstSlice, CV_8U, Alpha, Beta);
+  });
+}
+
+void IntegerToHalfVolume(const cv::Mat& Src, cv::Mat& Dst) {
+  check(Src.dims == 3 && Src.type() == CV_16SC1);
+  Dst.create(3, Src.size.p, CV_16SC1);
+
+  ParallelFor(Src.size[0], [&](int32 Z) {
+    cv::Mat Float;
+    GetSlice(Src, Z).convertTo(Float, CV_32F);
+    cv::Mat DstSlice = GetSlice(Dst, Z);
+    cv::convertFp16(Float, DstSlice);
+  });
+}
+
+void DownsampleVolume(const cv::Mat& Src, cv::Mat& Dst, bool bGaussian, bool bHalfFloat) {
+  check(Src.dims == 3 && Dst.dims == 3 && Src.channels() == 1 && Src.type() == Dst.type());
+
+  const int32 SrcSlices = Src.size[0];
+  const int32 DstSlices = Dst.size[0];
+  const cv::Size DstSize(Dst.size[2], Dst.size[1]);
+
+  const int32* Taps = bGaussian ? GaussTaps : BoxTaps;
+  const float* Weights = bGaussian ? GaussWeights : BoxWeights;
+  const int32 NumTaps = bGaussian ? ARRAY_COUNT(GaussTaps) : ARRAY_COUNT(BoxTaps);
+
+  const int32 NumSlabs = FMath::DivideAndRoundUp(DstSlices, SlicesPerSlab);
+  ParallelFor(NumSlabs, [&](int32 Slab) {
+    const int32 ZBegin = Slab * SlicesPerSlab;
+    const int32 ZEnd = FMath::Min(ZBegin + SlicesPerSlab, DstSlices);
+
+    // XY-reduced source slices of this slab, indexed relative to the first tap
+    const int32 FirstSrc = 2 * ZBegin + Taps[0];
+    TArray<cv::Mat> Reduced;
+    Reduced.SetNum(2 * (ZEnd - 1) + Taps[NumTaps - 1] - FirstSrc + 1);
+
+    cv::Mat Accumulator(DstSize, CV_32FC1);
+    for (int32 Z = ZBegin; Z < ZEnd; ++Z) {
+      Accumulator.setTo(0);
+      for (int32 Tap = 0; Tap < NumTaps; ++Tap) {
+        cv::Mat& Slice = Reduced[2 * Z + Taps[Tap] - FirstSrc];
+        if (Slice.empty()) {
+          const int32 SrcZ = ReflectSlice(2 * Z + Taps[Tap], SrcSlices);
+          Slice = ReduceSlice(GetSlice(Src, SrcZ), DstSize, bGaussian, bHalfFloat);
+        }
+        cv::scaleAdd(Slice, Weights[Tap], Accumulator, Accumulator);
+      }
+
+      cv::Mat DstSlice = GetSlice(Dst, Z);
+      if (bHalfFloat) {
+        cv::convertFp16(Accumulator, DstSlice);
+      } else {
+        Accumulator.convertTo(DstSlice, Dst.depth());
+      }
+    }
+  });
+}
+
+}  // namespace detail
@@ -0,0 +1,45 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+THIRD_PARTY_INCLUDES_START
+#include <opencv2/core.hpp>
+THIRD_PARTY_INCLUDES_END
+
+namespace detail {
+
+// Returns a 2D header for slice Z of the 3D matrix Volume (no data is copied)
+inline cv::Mat GetSlice(const cv::Mat& Volume, int32 Z) {
+  return cv::Mat(Volume.size[1], Volume.size[2], Volume.type(),
+                 const_cast<uchar*>(Volume.ptr(Z)), Volume.step[1]);
+}
+
+// Maps the single-channel 3D volume Src linearly from the window [Center - Width / 2,
+// Center + Width / 2] to [0, 255] and writes the saturated result into the 8-bit volume Dst, which
+// has to be allocated with the same size. Values are interpreted numerically, so signed 16-bit
+// data is treated as integers. Runs in parallel over slices.
+void WindowLevelToU8(const cv::Mat& Src, cv::Mat& Dst, float Center, float Width);
+
+// Converts the 16-bit integer 3D volume Src to half floats (stored as 16S, see cv::convertFp16)
+// in Dst, which is allocated if it does not have the size of Src yet. Integers up to 2048 in
+// magnitude are exact, larger ones are rounded to the nearest half float. Runs in parallel over
+// slices.
+void IntegerToHalfVolume(const cv::Mat& Src, cv::Mat& Dst);
+
+// Size of the next mip level of a volume: every dimension is halved (rounding down, at least 1)
+inline FIntVector GetNextMipSize(const FIntVector& Size) {
+  return FIntVector(FMath::Max(Size.X / 2, 1), FMath::Max(Size.Y / 2, 1),
+                    FMath::Max(Size.Z / 2, 1));
+}
+
+// Downsamples the single-channel 3D volume Src by 2 in every dimension into Dst, which has to be
+// allocated with the size given by GetNextMipSize and the type of Src. Uses a 2x2x2 box filter,
+// or a separable 5-tap binomial (Gaussian) filter if bGaussian is set. If bHalfFloat is set,
+// the 16-bit data is treated as half floats (see cv::convertFp16). Runs in parallel over Z slabs;
+// the per-slice work uses the vectorised cv::resize/cv::pyrDown and arithmetic routines.
+void DownsampleVolume(const cv::Mat& Src, cv::Mat& Dst, bool bGaussian, bool bHalfFloat);
+
+}  // namespace detail
@@ -0,0 +1,92 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#include "CVVolumeSlabCopy.h"
+
+#include "GlobalShader.h"
+#include "RHICommandList.h"
+#include "ShaderParameters.h"
+#include "ShaderParameterUtils.h"
+
+namespace {
+constexpr int32 ThreadGroupSize = 8;
+
+class FCVVolumeSlabCopyCS : public FGlobalShader {
+  DECLARE_SHADER_TYPE(FCVVolumeSlabCopyCS, Global);
+
+public:
+  static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters &Parameters) {
+    return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+  }
+
+  FCVVolumeSlabCopyCS() {}
+
+  FCVVolumeSlabCopyCS(const ShaderMetaType::CompiledShaderInitializerType &Initializer)
+      : FGlobalShader(Initializer) {
+    Volume.Bind(Initializer.ParameterMap, TEXT("Volume"));
+    Slab.Bind(Initializer.ParameterMap, TEXT("Slab"));
+    FirstSlice.Bind(Initializer.ParameterMap, TEXT("FirstSlice"));
+    SliceSize.Bind(Initializer.ParameterMap, TEXT("SliceSize"));
+    NumSlices.Bind(Initializer.ParameterMap, TEXT("NumSlices"));
+  }
+
+  virtual bool Serialize(FArchive &Ar) override {
+    const bool bShaderHasOutdatedParameters = FGlobalShader::Serialize(Ar);
+    Ar << Volume << Slab << FirstSlice << SliceSize << NumSlices;
+    return bShaderHasOutdatedParameters;
+  }
+
+  FShaderResourceParameter Volume;
+  FShaderResourceParameter Slab;
+  FShaderParameter FirstSlice;
+  FShaderParameter SliceSize;
+  FShaderParameter NumSlices;
+};
+
+IMPLEMENT_SHADER_TYPE(, FCVVolumeSlabCopyCS, TEXT("/Plugin/OpenCV/Private/CVVolumeSlabCopy.usf"),
+                      TEXT("MainCS"), SF_Compute);
+}  // namespace
+
+namespace detail {
+
+bool CanCopyVolumeSlab(EPixelFormat Format) {
+  if (GMaxRHIFeatureLevel < ERHIFeatureLevel::SM5) return false;
+
+  // Formats with a typed UAV store on all SM5 platforms and an OpenCV equivalent
+  switch (Format) {
+    case PF_G8:
+    case PF_G16:
+    case PF_R16F:
+    case PF_R32_FLOAT:
+    case PF_FloatRGBA:
+    case PF_A32B32G32R32F: return true;
+    default: return false;
+  }
+}
+
+void CopyVolumeSlab(FRHICommandListImmediate &RHICmdList, FTexture3DRHIParamRef Volume,
+                    int32 FirstSlice, int32 NumSlices, FUnorderedAccessViewRHIParamRef SlabUAV) {
+  TShaderMapRef<FCVVolumeSlabCopyCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+  FComputeShaderRHIParamRef ShaderRHI = ComputeShader->GetComputeShader();
+  RHICmdList.SetComputeShader(ShaderRHI);
+
+  const FIntPoint SliceSize(Volume->GetSizeX(), Volume->GetSizeY());
+  RHICmdList.TransitionResource(EResourceTransitionAccess::EWritable,
+                                EResourceTransitionPipeline::EGfxToCompute, SlabUAV);
+  SetTextureParameter(RHICmdList, ShaderRHI, ComputeShader->Volume, Volume);
+  SetUAVParameter(RHICmdList, ShaderRHI, ComputeShader->Slab, SlabUAV);
+  SetShaderValue(RHICmdList, ShaderRHI, ComputeShader->FirstSlice, FirstSlice);
+  SetShaderValue(RHICmdList, ShaderRHI, ComputeShader->SliceSize, SliceSize);
+  SetShaderValue(RHICmdList, ShaderRHI, ComputeShader->NumSlices, NumSlices);
+
+  RHICmdList.DispatchComputeShader(FMath::DivideAndRoundUp(SliceSize.X, ThreadGroupSize),
+                                   FMath::DivideAndRoundUp(SliceSize.Y * NumSlices,
+                                                           ThreadGroupSize),
+                                   1);
+
+  SetUAVParameter(RHICmdList, ShaderRHI, ComputeShader->Slab, FUnorderedAccessViewRHIRef());
+  RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable,
+                                EResourceTransitionPipeline::EComputeToGfx, SlabUAV);
+}
+
+}  // namespace detail
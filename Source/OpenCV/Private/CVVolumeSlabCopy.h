@@ -0,0 +1,23 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PixelFormat.h"
+#include "RHI.h"
+
+class FRHICommandListImmediate;
+
+namespace detail {
+
+// Returns true if slabs of volume textures of the given format can be copied with CopyVolumeSlab
+bool CanCopyVolumeSlab(EPixelFormat Format);
+
+// Copies the slices [FirstSlice, FirstSlice + NumSlices) of Volume into SlabUAV, a view of a 2D
+// texture of the volume's format and width and of NumSlices times its height. The slices end up
+// stacked vertically. Runs a compute shader, so it needs SM5.
+void CopyVolumeSlab(FRHICommandListImmediate &RHICmdList, FTexture3DRHIParamRef Volume,
+                    int32 FirstSlice, int32 NumSlices, FUnorderedAccessViewRHIParamRef SlabUAV);
+
+}  // namespace detail
@@ -0,0 +1,147 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#include "CVVolumeStreamingUpload.h"
+
+#include "CVVolumeUpload.h"
+#include "OpenCV_Common.h"
+
+#include "Containers/Ticker.h"
+#include "Engine/VolumeTexture.h"
+#include "HAL/PlatformTime.h"
+
+UCVVolumeStreamingUpload* UCVVolumeStreamingUpload::StreamToVolumeTexture(
+    UObject* WorldContextObject, UCVUMat* Mat, UVolumeTexture* VolumeTexture, int32 BrickSize,
+    int32 KiloBytesPerFrame, float MillisecondsPerFrame, bool KeepCpuCopy) {
+  auto* Action = NewObject<UCVVolumeStreamingUpload>();
+  Action->Mat = Mat;
+  Action->VolumeTexture = VolumeTexture;
+  Action->BrickSize = FMath::Max(BrickSize, 1);
+  Action->BytesPerFrame = static_cast<int64>(FMath::Max(KiloBytesPerFrame, 0)) * 1024;
+  Action->SecondsPerFrame = FMath::Max(MillisecondsPerFrame, 0.f) / 1000.0;
+  Action->bKeepCpuCopy = KeepCpuCopy;
+  Action->NextBrick = 0;
+  Action->UploadedBytes = 0;
+  Action->TotalBytes = 0;
+  Action->bAllBricksEnqueued = false;
+  Action->RegisterWithGameInstance(WorldContextObject);
+  return Action;
+}
+
+void UCVVolumeStreamingUpload::Activate() {
+  detail::FCVUploadFormat Format;
+  if (!Mat || !detail::ValidateVolume(Mat->m, Format)) {
+    Finish(false);
+    return;
+  }
+
+  // Shares the memory of Mat, which must not be modified until the upload has finished
+  Volume = Mat->m;
+  TotalBytes = static_cast<int64>(Volume.total() * Volume.elemSize());
+  const FIntVector Dimensions{Volume.size[2], Volume.size[1], Volume.size[0]};
+
+  try {
+    // Create an empty texture once, all bricks are then written in place on the render thread
+    if (!detail::CanUpdateVolumeInPlace(VolumeTexture, Dimensions, Format.PixelFormat)) {
+      detail::CreateVolumeResource(VolumeTexture, Dimensions, Format.PixelFormat, bKeepCpuCopy);
+    }
+    VolumeMapped = Volume.getMat(cv::ACCESS_READ);
+  } catch (cv::Exception& e) {
+    UE_LOG(OpenCV, Warning, TEXT("Function %s: Caught OpenCV Exception: %s"), TEXT(__FUNCTION__),
+           UTF8_TO_TCHAR(e.what()));
+    Finish(false);
+    return;
+  }
+
+  NumBricks = FIntVector(FMath::DivideAndRoundUp(Dimensions.X, BrickSize),
+                         FMath::DivideAndRoundUp(Dimensions.Y, BrickSize),
+                         FMath::DivideAndRoundUp(Dimensions.Z, BrickSize));
+
+  TickHandle = FTicker::GetCoreTicker().AddTicker(
+      FTickerDelegate::CreateUObject(this, &UCVVolumeStreamingUpload::Tick));
+}
+
+float UCVVolumeStreamingUpload::GetProgress() const {
+  return TotalBytes > 0 ? static_cast<float>(static_cast<double>(UploadedBytes) / TotalBytes)
+                        : 0.f;
+}
+
+void UCVVolumeStreamingUpload::Cancel() {
+  if (TickHandle.IsValid()) {
+    Finish(false);
+  }
+}
+
+bool UCVVolumeStreamingUpload::Tick(float DeltaTime) {
+  if (bAllBricksEnqueued) {
+    if (CompletionFence.IsFenceComplete()) {
+      // Returning false removes the ticker
+      TickHandle.Reset();
+      Finish(true);
+      return false;
+    }
+    return true;
+  }
+
+  const double StartTime = FPlatformTime::Seconds();
+  const int32 TotalBricks = NumBricks.X * NumBricks.Y * NumBricks.Z;
+  int64 FrameBytes = 0;
+
+  try {
+    // Bricks go slab by slab along Z, so the volume fills up from the front
+    while (NextBrick < TotalBricks) {
+      const int32 BX = NextBrick % NumBricks.X;
+      const int32 BY = (NextBrick / NumBricks.X) % NumBricks.Y;
+      const int32 BZ = NextBrick / (NumBricks.X * NumBricks.Y);
+
+      const cv::Range Box[3]{
+          {BZ * BrickSize, FMath::Min((BZ + 1) * BrickSize, Volume.size[0])},
+          {BY * BrickSize, FMath::Min((BY + 1) * BrickSize, Volume.size[1])},
+          {BX * BrickSize, FMath::Min((BX + 1) * BrickSize, Volume.size[2])}};
+      detail::UpdateVolumeBox(VolumeTexture, Volume, VolumeMapped, Box, bKeepCpuCopy);
+      ++NextBrick;
+
+      const int64 BrickBytes =
+          static_cast<int64>(Box[0].size()) * Box[1].size() * Box[2].size() * Volume.elemSize();
+      FrameBytes += BrickBytes;
+      UploadedBytes += BrickBytes;
+
+      if ((BytesPerFrame > 0 && FrameBytes >= BytesPerFrame) ||
+          (SecondsPerFrame > 0 && FPlatformTime::Seconds() - StartTime >= SecondsPerFrame)) {
+        break;
+      }
+    }
+  } catch (cv::Exception& e) {
+    UE_LOG(OpenCV, Warning, TEXT("Function %s: Caught OpenCV Exception: %s"), TEXT(__FUNCTION__),
+           UTF8_TO_TCHAR(e.what()));
+    TickHandle.Reset();
+    Finish(false);
+    return false;
+  }
+
+  OnProgress.Broadcast(VolumeTexture, GetProgress());
+
+  if (NextBrick == TotalBricks) {
+    bAllBricksEnqueued = true;
+    CompletionFence.BeginFence();
+  }
+  return true;
+}
+
+void UCVVolumeStreamingUpload::Finish(bool bSuccess) {
+  if (TickHandle.IsValid()) {
+    FTicker::GetCoreTicker().RemoveTicker(TickHandle);
+    TickHandle.Reset();
+  }
+
+  // The enqueued bricks hold their own references to the volume memory
+  VolumeMapped.release();
+  Volume.release();
+
+  if (bSuccess) {
+    OnCompleted.Broadcast(VolumeTexture, 1.f);
+  } else {
+    OnFailed.Broadcast(VolumeTexture, GetProgress());
+  }
+  SetReadyToDestroy();
+}
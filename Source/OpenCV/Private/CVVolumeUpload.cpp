@@ -0,0 +1,259 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#include "CVVolumeUpload.h"
+
+#include "CVVolumeKernels.h"
+#include "OpenCV_Common.h"
+
+#include "Engine/VolumeTexture.h"
+#include "RenderingThread.h"
+#include "RHI.h"
+#include "RHIStaticStates.h"
+#include "TextureResource.h"
+
+namespace {
+struct FUpdateVolumeRegionData {
+  FTextureResource *TextureResource;
+  FUpdateTextureRegion3D Region;
+  // Holding the UMat keeps the data alive until the mapped box is released
+  cv::UMat SrcUMat;
+  cv::Mat SrcBox;
+};
+
+// Volume texture resource whose RHI texture is created empty instead of from the mip bulk data
+class FCVEmptyVolumeResource : public FTextureResource {
+public:
+  FCVEmptyVolumeResource(UVolumeTexture *Owner, const FIntVector &InDimensions,
+                         EPixelFormat InPixelFormat)
+      : Dimensions(InDimensions),
+        PixelFormat(InPixelFormat),
+        TextureReferenceRHI(Owner->TextureReference.TextureReferenceRHI) {
+    bSRGB = false;
+    bGreyScaleFormat = PixelFormat == PF_G8;
+  }
+
+  virtual void InitRHI() override {
+    FRHIResourceCreateInfo CreateInfo;
+    FTexture3DRHIRef Texture3DRHI =
+        RHICreateTexture3D(Dimensions.X, Dimensions.Y, Dimensions.Z, PixelFormat, 1,
+                           TexCreate_ShaderResource, CreateInfo);
+    TextureRHI = Texture3DRHI;
+    TextureRHI->SetName(TEXT("CVEmptyVolume"));
+    RHIUpdateTextureReference(TextureReferenceRHI, TextureRHI);
+    SamplerStateRHI = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+  }
+
+  virtual void ReleaseRHI() override {
+    RHIUpdateTextureReference(TextureReferenceRHI, FTextureRHIParamRef());
+    FTextureResource::ReleaseRHI();
+  }
+
+  virtual uint32 GetSizeX() const override { return Dimensions.X; }
+  virtual uint32 GetSizeY() const override { return Dimensions.Y; }
+
+private:
+  FIntVector Dimensions;
+  EPixelFormat PixelFormat;
+  FTextureReferenceRHIRef TextureReferenceRHI;
+};
+}  // namespace
+
+namespace detail {
+
+bool ValidateVolume(const cv::UMat &m, FCVUploadFormat &OutFormat) {
+  if (m.total() == 0) {
+    UE_LOG(OpenCV, Error, TEXT("Cannot upload an empty matrix!"));
+    return false;
+  }
+  if (m.channels() != 1) {
+    UE_LOG(OpenCV, Error, TEXT("Channel mismatch: Volume has to be single-channel!"));
+    return false;
+  }
+  if (m.dims != 3) {
+    UE_LOG(OpenCV, Error, TEXT("Dimensionality mismatch: cv::UMat has to contain a 3D image!"));
+    return false;
+  }
+  if (!NegotiateVolumeFormat(m.type(), OutFormat)) {
+    UE_LOG(OpenCV, Error,
+           TEXT("Pixel type mismatch: cv::UMat has to be 8U, 16U, 16S or 32F!"));
+    return false;
+  }
+  return true;
+}
+
+void CopyVolumeVoxels(const cv::Mat &Src, cv::Mat &Dst) {
+  if (Src.depth() == CV_16S) {
+    IntegerToHalfVolume(Src, Dst);
+  } else {
+    Src.copyTo(Dst);
+  }
+}
+
+void UploadVolume(UVolumeTexture *&VolumeTexture, const FIntVector &Dimensions,
+                  const FCVUploadFormat &Format, ECVVolumeMipFilter MipFilter,
+                  TFunctionRef<void(cv::Mat &)> Fill) {
+  // Create a new texture if none was specified
+  if (!VolumeTexture) {
+    VolumeTexture = NewObject<UVolumeTexture>();
+  }
+
+  // TODO If an existing mip is selected and updated (through mip->BulkData), the change will
+  // not have an effect in packaged builds. Only newly created mips work. Investigate!
+  // (ToVolumeTextureSlices updates the RHI texture directly and does not have this problem.)
+
+  // Set volume texture parameters.
+  VolumeTexture->NeverStream = false;
+  VolumeTexture->SRGB = false;
+  VolumeTexture->bUAVCompatible = true;  // this requires the custom built engine
+
+  // Set PlatformData parameters (create PlatformData if it doesn't exist)
+  if (!VolumeTexture->PlatformData) {
+    VolumeTexture->PlatformData = new FTexturePlatformData();
+  }
+
+  VolumeTexture->PlatformData->PixelFormat = Format.PixelFormat;
+  VolumeTexture->PlatformData->SizeX = Dimensions.X;
+  VolumeTexture->PlatformData->SizeY = Dimensions.Y;
+  VolumeTexture->PlatformData->NumSlices = Dimensions.Z;
+
+  // If the texture already has MIPs in it, destroy and free them (Empty() calls destructors and
+  // frees space).
+  VolumeTexture->PlatformData->Mips.Empty();
+
+  FTexture2DMipMap *mip = new FTexture2DMipMap();
+  // Add the new MIP.
+  VolumeTexture->PlatformData->Mips.Add(mip);
+
+  mip->SizeX = Dimensions.X;
+  mip->SizeY = Dimensions.Y;
+  mip->SizeZ = Dimensions.Z;
+
+  const int64 TotalSize =
+      static_cast<int64>(Dimensions.X) * Dimensions.Y * Dimensions.Z * Format.ElementSize;
+  const int sz[3]{Dimensions.Z, Dimensions.Y, Dimensions.X};
+
+  const int cvType = PixelFormatToCvType(Format.PixelFormat);
+
+  mip->BulkData.Lock(EBulkDataLockFlags::LOCK_READ_WRITE);
+  uint8 *ByteArray = (uint8 *)mip->BulkData.Realloc(TotalSize);
+  cv::Mat wrap{3, sz, cvType, ByteArray};
+  Fill(wrap);
+
+  // Each level is filtered from the previous one, so that stays locked until the next is done
+  FIntVector MipSize = Dimensions;
+  while (MipFilter != ECVVolumeMipFilter::None && MipSize.GetMax() > 1) {
+    MipSize = GetNextMipSize(MipSize);
+
+    FTexture2DMipMap *NextMip = new FTexture2DMipMap();
+    VolumeTexture->PlatformData->Mips.Add(NextMip);
+    NextMip->SizeX = MipSize.X;
+    NextMip->SizeY = MipSize.Y;
+    NextMip->SizeZ = MipSize.Z;
+
+    const int MipSz[3]{MipSize.Z, MipSize.Y, MipSize.X};
+    NextMip->BulkData.Lock(EBulkDataLockFlags::LOCK_READ_WRITE);
+    cv::Mat MipWrap{3, MipSz, cvType,
+                    NextMip->BulkData.Realloc(static_cast<int64>(MipSize.X) * MipSize.Y *
+                                              MipSize.Z * Format.ElementSize)};
+    DownsampleVolume(wrap, MipWrap, MipFilter == ECVVolumeMipFilter::Gaussian,
+                     Format.PixelFormat == PF_R16F);
+
+    mip->BulkData.Unlock();
+    mip = NextMip;
+    wrap = MipWrap;
+  }
+  mip->BulkData.Unlock();
+
+  VolumeTexture->UpdateResource();
+}
+
+void CreateVolumeResource(UVolumeTexture *&VolumeTexture, const FIntVector &Dimensions,
+                          EPixelFormat PixelFormat, bool bAllocateBulkData) {
+  if (!VolumeTexture) {
+    VolumeTexture = NewObject<UVolumeTexture>();
+  }
+  VolumeTexture->NeverStream = false;
+  VolumeTexture->SRGB = false;
+
+  if (!VolumeTexture->PlatformData) {
+    VolumeTexture->PlatformData = new FTexturePlatformData();
+  }
+  // The platform data only describes the texture, the mip keeps its bulk data empty unless a CPU
+  // copy is requested
+  VolumeTexture->PlatformData->PixelFormat = PixelFormat;
+  VolumeTexture->PlatformData->SizeX = Dimensions.X;
+  VolumeTexture->PlatformData->SizeY = Dimensions.Y;
+  VolumeTexture->PlatformData->NumSlices = Dimensions.Z;
+  VolumeTexture->PlatformData->Mips.Empty();
+
+  FTexture2DMipMap *mip = new FTexture2DMipMap();
+  VolumeTexture->PlatformData->Mips.Add(mip);
+  mip->SizeX = Dimensions.X;
+  mip->SizeY = Dimensions.Y;
+  mip->SizeZ = Dimensions.Z;
+
+  if (bAllocateBulkData) {
+    mip->BulkData.Lock(EBulkDataLockFlags::LOCK_READ_WRITE);
+    mip->BulkData.Realloc(static_cast<int64>(Dimensions.X) * Dimensions.Y * Dimensions.Z *
+                          GPixelFormats[PixelFormat].BlockBytes);
+    mip->BulkData.Unlock();
+  }
+
+  // Replace the resource instead of calling UpdateResource(), which would initialize the RHI
+  // texture from the bulk data. ReleaseResource() also deletes the old resource.
+  VolumeTexture->ReleaseResource();
+  VolumeTexture->Resource = new FCVEmptyVolumeResource(VolumeTexture, Dimensions, PixelFormat);
+  BeginInitResource(VolumeTexture->Resource);
+}
+
+bool CanUpdateVolumeInPlace(const UVolumeTexture *VolumeTexture, const FIntVector &Dimensions,
+                            EPixelFormat PixelFormat) {
+  return VolumeTexture && VolumeTexture->Resource && VolumeTexture->PlatformData &&
+         VolumeTexture->PlatformData->Mips.IsValidIndex(0) &&
+         VolumeTexture->GetSizeX() == Dimensions.X && VolumeTexture->GetSizeY() == Dimensions.Y &&
+         VolumeTexture->GetSizeZ() == Dimensions.Z &&
+         VolumeTexture->GetPixelFormat() == PixelFormat;
+}
+
+void UpdateVolumeBox(UVolumeTexture *VolumeTexture, const cv::UMat &Src, const cv::Mat &SrcMat,
+                     const cv::Range (&Box)[3], bool bUpdateBulkData) {
+  cv::Mat SrcBox = SrcMat(Box);
+  if (SrcBox.depth() == CV_16S) {
+    // The converted box owns its memory, so the texture does not depend on Src any more
+    cv::Mat Half;
+    CopyVolumeVoxels(SrcBox, Half);
+    SrcBox = Half;
+  }
+
+  // Keep the CPU copy consistent if the texture still has one (e.g. for FromVolumeTexture)
+  FByteBulkData &BulkData = VolumeTexture->PlatformData->Mips[0].BulkData;
+  if (bUpdateBulkData && BulkData.IsBulkDataLoaded() &&
+      BulkData.GetBulkDataSize() == static_cast<int64>(SrcMat.total() * SrcMat.elemSize())) {
+    const int sz[3]{SrcMat.size[0], SrcMat.size[1], SrcMat.size[2]};
+    cv::Mat wrap{3, sz, SrcMat.type(), BulkData.Lock(LOCK_READ_WRITE)};
+    SrcBox.copyTo(wrap(Box));
+    BulkData.Unlock();
+  }
+
+  // The box ends up at the same position in the texture
+  const FUpdateTextureRegion3D Region(Box[2].start, Box[1].start, Box[0].start, 0, 0, 0,
+                                      SrcBox.size[2], SrcBox.size[1], SrcBox.size[0]);
+  auto RegionData = new FUpdateVolumeRegionData{VolumeTexture->Resource, Region, Src, SrcBox};
+
+  ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(
+      UpdateVolumeRegionData, FUpdateVolumeRegionData *, RegionData, RegionData, {
+        FTexture3DRHIRef TextureRHI = RegionData->TextureResource->TextureRHI
+                                          ? RegionData->TextureResource->TextureRHI->GetTexture3D()
+                                          : nullptr;
+        if (TextureRHI) {
+          RHIUpdateTexture3D(TextureRHI, 0, RegionData->Region,
+                             static_cast<uint32>(RegionData->SrcBox.step[1]),
+                             static_cast<uint32>(RegionData->SrcBox.step[0]),
+                             RegionData->SrcBox.data);
+        }
+        delete RegionData;
+      });
+}
+
+}  // namespace detail
@@ -0,0 +1,54 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "CVTextureFormats.h"
+#include "UCVUMat.h"
+
+THIRD_PARTY_INCLUDES_START
+#include <opencv2/core.hpp>
+THIRD_PARTY_INCLUDES_END
+
+class UVolumeTexture;
+
+namespace detail {
+
+// Checks that m holds a volume that can be uploaded to a volume texture and picks its format
+bool ValidateVolume(const cv::UMat &m, FCVUploadFormat &OutFormat);
+
+// Writes the voxels of Src into Dst in the texture format chosen by ValidateVolume: 16S integers
+// are converted to half floats, all other types are copied as-is. Dst is allocated if it does not
+// have the size of Src yet.
+void CopyVolumeVoxels(const cv::Mat &Src, cv::Mat &Dst);
+
+// (Re)creates the mips of VolumeTexture with the given size and format, lets Fill write the
+// voxels into the memory of mip 0, builds the lower mips with MipFilter and recreates the texture
+// resource
+void UploadVolume(UVolumeTexture *&VolumeTexture, const FIntVector &Dimensions,
+                  const FCVUploadFormat &Format, ECVVolumeMipFilter MipFilter,
+                  TFunctionRef<void(cv::Mat &)> Fill);
+
+// (Re)creates VolumeTexture with a single mip of the given size and format. The RHI texture is
+// created without initial data (its contents are undefined until written with UpdateVolumeBox),
+// so nothing is allocated, filled or copied on the game thread. The mip bulk data is only
+// allocated (uninitialized) if bAllocateBulkData is set, otherwise the texture has no CPU copy.
+void CreateVolumeResource(UVolumeTexture *&VolumeTexture, const FIntVector &Dimensions,
+                          EPixelFormat PixelFormat, bool bAllocateBulkData);
+
+// Returns true if VolumeTexture has a resource of the given size and format, so parts of it can be
+// updated with UpdateVolumeBox
+bool CanUpdateVolumeInPlace(const UVolumeTexture *VolumeTexture, const FIntVector &Dimensions,
+                            EPixelFormat PixelFormat);
+
+// Enqueues an update of mip 0 of VolumeTexture with Box of the 3D matrix Src, straight from the
+// matrix memory (16S boxes are converted with CopyVolumeVoxels first) and without recreating the
+// RHI texture. Box holds explicit Z, Y, X ranges (not
+// cv::Range::all()), SrcMat is Src mapped for reading. If bUpdateBulkData is set, the mip bulk data
+// is updated as well if it is resident.
+void UpdateVolumeBox(UVolumeTexture *VolumeTexture, const cv::UMat &Src, const cv::Mat &SrcMat,
+                     const cv::Range (&Box)[3], bool bUpdateBulkData = true);
+
+}  // namespace detail
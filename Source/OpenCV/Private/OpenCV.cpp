@@ -5,6 +5,7 @@
 #include "Core.h"
 #include "IPluginManager.h"
 #include "ModuleManager.h"
+#include "ShaderCore.h"
 
 #define LOCTEXT_NAMESPACE "FOpenCVModule"
 
@@ -18,6 +19,10 @@ void FOpenCVModule::StartupModule() {
   // Get the base directory of this plugin
   FString BaseDir = IPluginManager::Get().FindPlugin("OpenCV")->GetBaseDir();
 
+  // Global shaders are compiled right after this module is loaded (PostConfigInit)
+  AddShaderSourceDirectoryMapping(TEXT("/Plugin/OpenCV"),
+                                  FPaths::Combine(BaseDir, TEXT("Shaders")));
+
   // Add on the relative location of the third party dll and load it
   FString LibraryPath;
 #if PLATFORM_WINDOWS
@@ -3,17 +3,36 @@
 
 #include "UCVUMat.h"
 
+#include "CVBufferedRenderTarget.h"
+#include "CVStagingBufferPool.h"
+#include "CVTextureFormats.h"
+#include "CVUploadKernels.h"
+#include "CVVolumeFile.h"
+#include "CVVolumeKernels.h"
+#include "CVVolumeUpload.h"
 #include "OpenCV_Common.h"
 
+#include "Async/ParallelFor.h"
 #include "Engine/Texture2D.h"
 #include "Engine/TextureRenderTarget2D.h"
 #include "Engine/VolumeTexture.h"
+#include "HAL/IConsoleManager.h"
 
 THIRD_PARTY_INCLUDES_START
+#include <opencv2/core/ocl.hpp>
 #include <opencv2/opencv.hpp>
 THIRD_PARTY_INCLUDES_END
 
-#define UPDATE_VOLUME_THROUGH_MIPS 1
+static TAutoConsoleVariable<int32> CVarZeroCopyUpload(
+    TEXT("OpenCV.ZeroCopyUpload"), 0,
+    TEXT("If enabled, matrices that need no format conversion are uploaded directly from their\n")
+        TEXT("memory on the render thread instead of being copied into a staging buffer first.\n")
+        TEXT("The mapped matrix must not be written in place until the upload is done.\n")
+        TEXT("Matrices backed by an OpenCL buffer are always copied. Default: 0"),
+    ECVF_Default);
+
+DECLARE_CYCLE_STAT(TEXT("Upload Convert"), STAT_OpenCV_UploadConvert, STATGROUP_OpenCV);
+DECLARE_CYCLE_STAT(TEXT("Texture Update (RT)"), STAT_OpenCV_TextureUpdate, STATGROUP_OpenCV);
 
 UCVUMat::UCVUMat() {
 #if CV_ENABLE_INSTANCE_TRACKING
@@ -34,118 +53,323 @@ UCVUMat::~UCVUMat() {
 #endif
 };
 
+namespace detail {
+// Returns the OpenCV type of a Blueprint matrix type, -1 for Empty/Unknown
+int MatTypeToCvType(FCVMatType Type) {
+  switch (Type) {
+    case FCVMatType::CVT_8UC1: return CV_8UC1;
+    case FCVMatType::CVT_16UC1: return CV_16UC1;
+    case FCVMatType::CVT_8SC1: return CV_8SC1;
+    case FCVMatType::CVT_16SC1: return CV_16SC1;
+    case FCVMatType::CVT_32SC1: return CV_32SC1;
+    case FCVMatType::CVT_32FC1: return CV_32FC1;
+    case FCVMatType::CVT_8UC3: return CV_8UC3;
+    case FCVMatType::CVT_8UC4: return CV_8UC4;
+    default: return -1;
+  }
+}
+
+// Creates a UCVUMat from the voxel data of a volume file, see MapVolumeFile
+UCVUMat *LoadVolume(const FCVVolumeFileLayout &Layout) {
+  try {
+    cv::Mat Volume;
+    if (!MapVolumeFile(Layout, Volume)) {
+      return nullptr;
+    }
+    // The UMat keeps a reference to the mapped memory, nothing is copied
+    auto *Result = NewObject<UCVUMat>();
+    Result->m = Volume.getUMat(cv::ACCESS_READ);
+    return Result;
+  } catch (cv::Exception &e) {
+    UE_LOG(OpenCV, Warning, TEXT("Function %s: Caught OpenCV Exception: %s"), TEXT(__FUNCTION__),
+           UTF8_TO_TCHAR(e.what()));
+    return nullptr;
+  }
+}
+}  // namespace detail
+
 UCVUMat *UCVUMat::CreateMat(int32 rows, int32 cols, FCVMatType type /* = FCVMatType::CVT_EMPTY*/,
                             UCVUMat *existingMat /* = nullptr*/) {
   auto *r = existingMat ? existingMat : NewObject<UCVUMat>();
-  int cvType = 0;
-
-  switch (type) {
-    case FCVMatType::CVT_8UC1: cvType = CV_8UC1; break;
-    case FCVMatType::CVT_16UC1: cvType = CV_16UC1; break;
-    case FCVMatType::CVT_8SC1: cvType = CV_8SC1; break;
-    case FCVMatType::CVT_16SC1: cvType = CV_16SC1; break;
-    case FCVMatType::CVT_32SC1: cvType = CV_32SC1; break;
-    case FCVMatType::CVT_8UC3: cvType = CV_8UC3; break;
-    case FCVMatType::CVT_8UC4: cvType = CV_8UC4; break;
-  }
+  const int cvType = detail::MatTypeToCvType(type);
 
   // Init if we have a defined type
-  if (cvType) {
+  if (cvType != -1) {
     r->m.create(rows, cols, cvType);
   }
 
   return r;
 }
 
+UCVUMat *UCVUMat::LoadRawVolume(const FString &FileName, FIntVector Dimensions, FCVMatType Type,
+                                int32 HeaderSize) {
+  detail::FCVVolumeFileLayout Layout;
+  Layout.DataFile = FileName;
+  Layout.DataOffset = HeaderSize;
+  Layout.Dimensions = Dimensions;
+  Layout.CvType = detail::MatTypeToCvType(Type);
+
+  if (Layout.CvType == -1 || Dimensions.GetMin() <= 0) {
+    UE_LOG(OpenCV, Error, TEXT("Invalid volume type or dimensions!"));
+    return nullptr;
+  }
+
+  return detail::LoadVolume(Layout);
+}
+
+UCVUMat *UCVUMat::LoadMetaImage(const FString &FileName, FVector &Spacing) {
+  detail::FCVVolumeFileLayout Layout;
+  if (!detail::ReadMetaImageHeader(FileName, Layout)) {
+    return nullptr;
+  }
+  Spacing = Layout.Spacing;
+
+  return detail::LoadVolume(Layout);
+}
+
 namespace detail {
 template <typename TextureResourceType> struct FUpdateTextureRegionsData {
   TextureResourceType *TextureResource;
-  uint32 NumRegions;
-  FUpdateTextureRegion2D *Regions;
+  TArray<FUpdateTextureRegion2D, TInlineAllocator<1>> Regions;
   uint32 SrcPitch;
   uint32 SrcBpp;
   uint8 *SrcData;
+  // Pooled memory backing SrcData, handed back to the pool once the upload is submitted
+  FCVStagingBuffer StagingBuffer;
+  // For zero-copy uploads, SrcData points into SrcMat. Holding the UMat as well keeps the
+  // underlying UMatData alive until the mapped Mat is released (members destruct in reverse order)
+  cv::UMat SrcUMat;
+  cv::Mat SrcMat;
 };
 
+inline FTexture2DRHIRef GetTexture2DRHI(FTexture2DResource *TextureResource) {
+  return TextureResource->GetTexture2DRHI();
+}
+
+inline FTexture2DRHIRef GetTexture2DRHI(FTextureRenderTarget2DResource *TextureResource) {
+  return TextureResource->GetTextureRHI();
+}
+
 // Use this function to update the texture rects you want to change:
 // NOTE: This is very similar to a in UTexture2D::UpdateTextureRegions but it is compiled
 // WITH_EDITOR and is not marked as ENGINE_API so it cannot be linked from plugins.
 // Adapted from https://wiki.unrealengine.com/Dynamic_Textures
-void UpdateTextureRegions(FTexture2DResource *TextureResource, uint32 NumRegions,
-                          FUpdateTextureRegion2D *Regions, uint32 SrcPitch, uint32 SrcBpp,
-                          uint8 *SrcData, bool bFreeData) {
-  auto RegionData = new FUpdateTextureRegionsData<FTexture2DResource>{
-      TextureResource, NumRegions, Regions, SrcPitch, SrcBpp, SrcData};
-
-  ENQUEUE_UNIQUE_RENDER_COMMAND_TWOPARAMETER(
-      UpdateTextureRegionsData, FUpdateTextureRegionsData<FTexture2DResource> *, RegionData,
-      RegionData, bool, bFreeData, bFreeData, {
-        for (uint32 RegionIndex = 0; RegionIndex < RegionData->NumRegions; ++RegionIndex) {
-          RHIUpdateTexture2D(RegionData->TextureResource->GetTexture2DRHI(), 0,
-                             RegionData->Regions[RegionIndex], RegionData->SrcPitch,
-                             RegionData->SrcData +
-                                 RegionData->Regions[RegionIndex].SrcY * RegionData->SrcPitch +
-                                 RegionData->Regions[RegionIndex].SrcX * RegionData->SrcBpp);
-        }
-        if (bFreeData) {
-          FMemory::Free(RegionData->Regions);
-          FMemory::Free(RegionData->SrcData);
+// Takes ownership of RegionData.
+template <typename TextureResourceType>
+void UpdateTextureRegions(FUpdateTextureRegionsData<TextureResourceType> *RegionData) {
+  using FRegionDataPtr = FUpdateTextureRegionsData<TextureResourceType> *;
+
+  ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(
+      UpdateTextureRegionsData, FRegionDataPtr, RegionData, RegionData, {
+        SCOPE_CYCLE_COUNTER(STAT_OpenCV_TextureUpdate);
+        FTexture2DRHIRef TextureRHI = GetTexture2DRHI(RegionData->TextureResource);
+        for (const FUpdateTextureRegion2D &Region : RegionData->Regions) {
+          RHIUpdateTexture2D(TextureRHI, 0, Region, RegionData->SrcPitch,
+                             RegionData->SrcData + Region.SrcY * RegionData->SrcPitch +
+                                 Region.SrcX * RegionData->SrcBpp);
         }
+        FCVStagingBufferPool::Get().Release(RegionData->StagingBuffer);
         delete RegionData;
       });
 }
 
-void UpdateTextureRegions(FTextureRenderTarget2DResource *TextureResource, uint32 NumRegions,
-                          FUpdateTextureRegion2D *Regions, uint32 SrcPitch, uint32 SrcBpp,
-                          uint8 *SrcData, bool bFreeData) {
-  auto RegionData = new FUpdateTextureRegionsData<FTextureRenderTarget2DResource>{
-      TextureResource, NumRegions, Regions, SrcPitch, SrcBpp, SrcData};
-
-  ENQUEUE_UNIQUE_RENDER_COMMAND_TWOPARAMETER(
-      UpdateTextureRegionsData, FUpdateTextureRegionsData<FTextureRenderTarget2DResource> *,
-      RegionData, RegionData, bool, bFreeData, bFreeData, {
-        for (uint32 RegionIndex = 0; RegionIndex < RegionData->NumRegions; ++RegionIndex) {
-          RHIUpdateTexture2D(RegionData->TextureResource->GetTextureRHI(), 0,
-                             RegionData->Regions[RegionIndex], RegionData->SrcPitch,
-                             RegionData->SrcData +
-                                 RegionData->Regions[RegionIndex].SrcY * RegionData->SrcPitch +
-                                 RegionData->Regions[RegionIndex].SrcX * RegionData->SrcBpp);
+// Serial number of the last upload to each texture, so a UCVUMat can tell whether anybody else
+// uploaded to it since its own last upload (bUploadChangedTilesOnly). Game thread only.
+TMap<TWeakObjectPtr<UTexture>, uint64> GTextureUploadSerials;
+uint64 GNextTextureUploadSerial = 1;
+
+uint64 GetLastUploadSerial(UTexture *Target) {
+  const uint64 *Serial = GTextureUploadSerials.Find(Target);
+  return Serial ? *Serial : 0;
+}
+
+// Records an upload to Target and returns its serial number
+uint64 RecordUpload(UTexture *Target) {
+  check(IsInGameThread());
+  // Forget textures that were garbage collected every now and then
+  if (GTextureUploadSerials.Num() > 256) {
+    for (auto It = GTextureUploadSerials.CreateIterator(); It; ++It) {
+      if (!It.Key().IsValid()) It.RemoveCurrent();
+    }
+  }
+  const uint64 Serial = GNextTextureUploadSerial++;
+  GTextureUploadSerials.Add(Target, Serial);
+  return Serial;
+}
+
+// Compares Current against Previous in tiles of TileSize x TileSize pixels, copies the changed
+// tiles over to Previous and returns them merged into horizontal runs
+void FindChangedTiles(const cv::Mat &Current, cv::Mat &Previous, int TileSize,
+                      TArray<FIntRect> &OutRects) {
+  const int TilesX = (Current.cols + TileSize - 1) / TileSize;
+  const int TilesY = (Current.rows + TileSize - 1) / TileSize;
+  const size_t ElemSize = Current.elemSize();
+
+  TArray<TArray<FIntRect>> RowRects;
+  RowRects.SetNum(TilesY);
+
+  ParallelFor(TilesY, [&](int32 TileY) {
+    const int Y0 = TileY * TileSize;
+    const int Y1 = FMath::Min(Y0 + TileSize, Current.rows);
+    int RunStart = -1;
+
+    for (int TileX = 0; TileX <= TilesX; ++TileX) {
+      bool bChanged = false;
+      if (TileX < TilesX) {
+        const int X0 = TileX * TileSize;
+        const size_t Offset = X0 * ElemSize;
+        const size_t Bytes = (FMath::Min(X0 + TileSize, Current.cols) - X0) * ElemSize;
+
+        for (int y = Y0; y < Y1 && !bChanged; ++y) {
+          bChanged = FMemory::Memcmp(Current.ptr(y) + Offset, Previous.ptr(y) + Offset, Bytes) != 0;
         }
-        if (bFreeData) {
-          FMemory::Free(RegionData->Regions);
-          FMemory::Free(RegionData->SrcData);
+        if (bChanged) {
+          for (int y = Y0; y < Y1; ++y) {
+            FMemory::Memcpy(Previous.ptr(y) + Offset, Current.ptr(y) + Offset, Bytes);
+          }
         }
-        delete RegionData;
-      });
+      }
+
+      if (bChanged && RunStart < 0) {
+        RunStart = TileX;
+      } else if (!bChanged && RunStart >= 0) {
+        RowRects[TileY].Emplace(RunStart * TileSize, Y0,
+                                FMath::Min(TileX * TileSize, Current.cols), Y1);
+        RunStart = -1;
+      }
+    }
+  });
+
+  for (const TArray<FIntRect> &Rects : RowRects) {
+    OutRects.Append(Rects);
+  }
+}
+
+// True if the UMat data lives in an OpenCL buffer. Mapping such a matrix for a zero-copy upload
+// would keep it mapped until the render thread is done, blocking (or forcing syncs for) every
+// OpenCL kernel touching it in the meantime, so these are copied into a staging buffer instead.
+inline bool HasDeviceCopy(const cv::UMat &m) {
+  return cv::ocl::useOpenCL() && m.u && m.u->handle;
 }
 
+// Converts/copies the matrix into the format expected by the texture and enqueues the upload.
+// If the matrix size differs from VideoSizeX/VideoSizeY, it is resized on the fly (m itself is
+// not modified). If DirtyRects is given, only these parts of the texture are converted and
+// updated; this is ignored when resizing.
 template <typename TextureResourceType>
 void ConvertAndUpload(size_t requiredDataSize, int requiredConversion, cv::UMat &m,
                       uint32_t requiredDataWrapType, TextureResourceType *resource,
-                      uint32 targetElementSize, uint32 VideoSizeX, uint32 VideoSizeY) {
-  auto VideoUpdateTextureRegion = new FUpdateTextureRegion2D{0, 0, 0, 0, VideoSizeX, VideoSizeY};
-
-  auto dataPtr = new uint8[requiredDataSize];
-  if (requiredConversion != -1) {
-    // wrap a cv::Mat around the buffer
-    cv::Mat dataWrap(m.size(), requiredDataWrapType, dataPtr);
-    // convert to the right layout (FColor is BGRA)
-    cv::cvtColor(m, dataWrap, requiredConversion);
+                      uint32 targetElementSize, uint32 VideoSizeX, uint32 VideoSizeY,
+                      const TArray<FIntRect> *DirtyRects = nullptr) {
+  auto RegionData = new FUpdateTextureRegionsData<TextureResourceType>();
+  RegionData->TextureResource = resource;
+  // Pitch of the tightly packed staging buffer, replaced by the row step for zero-copy uploads
+  RegionData->SrcPitch = targetElementSize * VideoSizeX;
+  RegionData->SrcBpp = targetElementSize;
+
+  const bool bResize = m.cols != static_cast<int>(VideoSizeX) ||
+                       m.rows != static_cast<int>(VideoSizeY);
+
+  if (DirtyRects && !bResize) {
+    const FIntRect Bounds{0, 0, static_cast<int32>(VideoSizeX), static_cast<int32>(VideoSizeY)};
+    for (FIntRect Rect : *DirtyRects) {
+      Rect.Clip(Bounds);
+      if (Rect.Area() > 0) {
+        RegionData->Regions.Emplace(Rect.Min.X, Rect.Min.Y, Rect.Min.X, Rect.Min.Y, Rect.Width(),
+                                    Rect.Height());
+      }
+    }
+    if (RegionData->Regions.Num() == 0) {
+      delete RegionData;
+      return;
+    }
+  } else {
+    RegionData->Regions.Emplace(0, 0, 0, 0, VideoSizeX, VideoSizeY);
+  }
 
-    UpdateTextureRegions(resource, (uint32)1, VideoUpdateTextureRegion,
-                         (uint32)(targetElementSize * VideoSizeX), targetElementSize, dataPtr,
-                         true);
+  if (requiredConversion == -1 && !bResize && CVarZeroCopyUpload.GetValueOnGameThread() != 0 &&
+      !HasDeviceCopy(m)) {
+    // The layout already matches, so the render thread uploads straight from the matrix memory.
+    // Using the row step as pitch also covers ROIs of larger matrices without cloning them.
+    RegionData->SrcUMat = m;
+    RegionData->SrcMat = m.getMat(cv::ACCESS_READ);
+    RegionData->SrcData = RegionData->SrcMat.data;
+    RegionData->SrcPitch = static_cast<uint32>(RegionData->SrcMat.step[0]);
   } else {
-    auto mat = m.getMat(cv::ACCESS_READ);
-    memcpy(dataPtr, mat.data, requiredDataSize);
-    UpdateTextureRegions(resource, (uint32)1, VideoUpdateTextureRegion,
-                         (uint32)(targetElementSize * VideoSizeX), targetElementSize, dataPtr,
-                         true);
+    SCOPE_CYCLE_COUNTER(STAT_OpenCV_UploadConvert);
+    RegionData->StagingBuffer = FCVStagingBufferPool::Get().Acquire(requiredDataSize);
+    RegionData->SrcData = RegionData->StagingBuffer.Data;
+
+    // wrap a cv::Mat around the buffer
+    cv::Mat dataWrap(VideoSizeY, VideoSizeX, requiredDataWrapType, RegionData->SrcData);
+    cv::Mat mat = m.getMat(cv::ACCESS_READ);
+
+    if (bResize) {
+      // resize and convert straight into the staging buffer
+      ResizeAndConvert(mat, dataWrap, requiredConversion);
+    } else {
+      for (const FUpdateTextureRegion2D &Region : RegionData->Regions) {
+        const cv::Rect Roi(Region.SrcX, Region.SrcY, Region.Width, Region.Height);
+        if (requiredConversion != -1) {
+          // convert to the right layout (FColor is BGRA), preferably with the SIMD kernels
+          cv::Mat dataRoi = dataWrap(Roi);
+          if (!ConvertToBGRA(mat(Roi), dataRoi)) {
+            cv::cvtColor(mat(Roi), dataRoi, requiredConversion);
+          }
+        } else {
+          mat(Roi).copyTo(dataWrap(Roi));
+        }
+      }
+    }
   }
+
+  UpdateTextureRegions(RegionData);
 }
 }  // namespace detail
 
 void UCVUMat::ToRenderTarget(UTextureRenderTarget2D *&RenderTarget, bool resize) {
+  UploadToRenderTarget(RenderTarget, resize, nullptr);
+}
+
+int32 UCVUMat::ToBufferedRenderTarget(UCVBufferedRenderTarget *&Target, bool Resize) {
+  if (!Target) {
+    Target = UCVBufferedRenderTarget::Create(2);
+  }
+  return Target->Upload(this, Resize);
+}
+
+void UCVUMat::ToRenderTargetRegions(UTextureRenderTarget2D *&RenderTarget,
+                                    const TArray<FIntRect> &Regions) {
+  UploadToRenderTarget(RenderTarget, false, &Regions);
+}
+
+void UCVUMat::ToTexture(UTexture2D *&Texture, bool Resize) {
+  UploadToTexture(Texture, Resize, nullptr);
+}
+
+void UCVUMat::ToTextureRegions(UTexture2D *&Texture, const TArray<FIntRect> &Regions) {
+  UploadToTexture(Texture, false, &Regions);
+}
+
+const TArray<FIntRect> *UCVUMat::GetChangedTiles(UTexture *Target, bool bTargetReset,
+                                                  TArray<FIntRect> &OutTiles) {
+  cv::Mat Current = m.getMat(cv::ACCESS_READ);
+
+  // Anything that invalidates the copy of the previous upload requires a full upload, including
+  // uploads of other matrices to the same texture
+  if (bTargetReset || PreviousUploadTarget.Get() != Target ||
+      PreviousUploadSerial != detail::GetLastUploadSerial(Target) ||
+      PreviousUpload.size() != Current.size() || PreviousUpload.type() != Current.type()) {
+    Current.copyTo(PreviousUpload);
+    return nullptr;
+  }
+
+  detail::FindChangedTiles(Current, PreviousUpload, FMath::Max(ChangedTileSize, 1), OutTiles);
+  return &OutTiles;
+}
+
+void UCVUMat::UploadToRenderTarget(UTextureRenderTarget2D *&RenderTarget, bool resize,
+                                   const TArray<FIntRect> *Regions) {
   uint32 VideoSizeX = m.cols;
   uint32 VideoSizeY = m.rows;
   auto size = cv::Size{m.size()};
@@ -156,47 +380,62 @@ void UCVUMat::ToRenderTarget(UTextureRenderTarget2D *&RenderTarget, bool resize)
       RenderTarget = NewObject<UTextureRenderTarget2D>();
     }
 
-    // For render Targets, we always convert to BGRA as no other reasonable formats are supported
-    EPixelFormat requiredPF{EPixelFormat::PF_B8G8R8A8};
-    uint32 targetElementSize{4};
-
-    int requiredConversion{-1};  // The OpenCV conversion parameter as used by cv::cvtColor
-
-    switch (m.type()) {
-      case CV_8UC1: requiredConversion = CV_GRAY2BGRA; break;
-      case CV_8UC3: requiredConversion = CV_BGR2BGRA; break;
-      case CV_8UC4:
-        requiredConversion = -1;  // direct copy
-        break;
-      default:
-        UE_LOG(OpenCV, Warning, TEXT("It seems that the OpenCV type is not supported!"));
-        return;
+    detail::FCVUploadFormat uploadFormat;
+    if (!detail::NegotiateUploadFormat(m.type(), uploadFormat)) {
+      UE_LOG(OpenCV, Warning, TEXT("It seems that the OpenCV type is not supported!"));
+      return;
     }
 
+    const EPixelFormat requiredPF{uploadFormat.PixelFormat};
+    const uint32 targetElementSize{uploadFormat.ElementSize};
+    const int requiredConversion{uploadFormat.Conversion};
+
     // Reinitialize texture if necessary
+    bool bTargetReset = false;
     if (RenderTarget->GetFormat() != requiredPF) {
       RenderTarget->InitCustomFormat(VideoSizeX, VideoSizeY, requiredPF, true);
       RenderTarget->UpdateResourceImmediate(false);
+      bTargetReset = true;
     }
 
     // check if we should resize
     if (m.cols != RenderTarget->SizeX || m.rows != RenderTarget->SizeY) {
       if (resize) {
-        cv::resize(m, m, cv::Size{RenderTarget->SizeX, RenderTarget->SizeY});
+        // the resize happens during the conversion to the staging buffer
         VideoSizeX = RenderTarget->SizeX;
         VideoSizeY = RenderTarget->SizeY;
       } else {
         RenderTarget->InitCustomFormat(VideoSizeX, VideoSizeY, requiredPF, true);
         RenderTarget->UpdateResourceImmediate(false);
+        bTargetReset = true;
       }
     }
 
-    size_t requiredDataSize{m.total() * targetElementSize};
-    uint32_t requiredDataWrapType{CV_8UC(targetElementSize)};
+    // Partial updates are only meaningful if the previous contents of the target are still valid
+    TArray<FIntRect> ChangedTiles;
+    const bool bResize = m.cols != static_cast<int>(VideoSizeX) ||
+                         m.rows != static_cast<int>(VideoSizeY);
+    const TArray<FIntRect> *DirtyRects = bTargetReset ? nullptr : Regions;
+    const bool bTrackChanges = bUploadChangedTilesOnly && !Regions && !bResize;
+    if (bTrackChanges) {
+      DirtyRects = GetChangedTiles(RenderTarget, bTargetReset, ChangedTiles);
+    }
+    // The baseline is only valid once this upload went through
+    PreviousUploadTarget = nullptr;
+
+    size_t requiredDataSize{size_t(VideoSizeX) * VideoSizeY * targetElementSize};
+    uint32_t requiredDataWrapType{
+        static_cast<uint32_t>(requiredConversion != -1 ? CV_8UC(targetElementSize) : m.type())};
     auto resource = static_cast<FTextureRenderTarget2DResource *>(RenderTarget->Resource);
 
     detail::ConvertAndUpload(requiredDataSize, requiredConversion, m, requiredDataWrapType,
-                             resource, targetElementSize, VideoSizeX, VideoSizeY);
+                             resource, targetElementSize, VideoSizeX, VideoSizeY, DirtyRects);
+
+    const uint64 Serial = detail::RecordUpload(RenderTarget);
+    if (bTrackChanges) {
+      PreviousUploadTarget = RenderTarget;
+      PreviousUploadSerial = Serial;
+    }
 
   } catch (cv::Exception &e) {
     UE_LOG(OpenCV, Warning, TEXT("Function %s: Caught OpenCV Exception: %s"), TEXT(__FUNCTION__),
@@ -204,7 +443,7 @@ void UCVUMat::ToRenderTarget(UTextureRenderTarget2D *&RenderTarget, bool resize)
   }
 }
 
-void UCVUMat::ToTexture(UTexture2D *&Texture, bool Resize) {
+void UCVUMat::UploadToTexture(UTexture2D *&Texture, bool Resize, const TArray<FIntRect> *Regions) {
   uint32 VideoSizeX = m.cols;
   uint32 VideoSizeY = m.rows;
   auto size = cv::Size{m.size()};
@@ -215,42 +454,28 @@ void UCVUMat::ToTexture(UTexture2D *&Texture, bool Resize) {
   }
 
   try {
-    EPixelFormat requiredPF{EPixelFormat::PF_Unknown};
-    int requiredConversion{-1};  // The OpenCV conversion parameter as used by cv::cvtColor
-    uint32 targetElementSize{0};
-
-    switch (m.type()) {
-      case CV_8UC1:  // convert to R8
-        requiredPF = EPixelFormat::PF_G8;
-        requiredConversion = -1;  // direct copy
-        targetElementSize = 1;
-        break;
-      case CV_8UC3:  // convert to BGRA
-        requiredPF = EPixelFormat::PF_B8G8R8A8;
-        requiredConversion = CV_BGR2BGRA;
-        targetElementSize = 4;
-        break;
-      case CV_8UC4:  // convert to BGRA
-        requiredPF = EPixelFormat::PF_B8G8R8A8;
-        requiredConversion = -1;  // direct copy
-        targetElementSize = 4;
-        break;
-      default:
-        UE_LOG(OpenCV, Warning, TEXT("It seems that the OpenCV type is not supported!"));
-        return;
-        break;
+    detail::FCVUploadFormat uploadFormat;
+    if (!detail::NegotiateUploadFormat(m.type(), uploadFormat)) {
+      UE_LOG(OpenCV, Warning, TEXT("It seems that the OpenCV type is not supported!"));
+      return;
     }
 
+    const EPixelFormat requiredPF{uploadFormat.PixelFormat};
+    const uint32 targetElementSize{uploadFormat.ElementSize};
+    const int requiredConversion{uploadFormat.Conversion};
+
     // create/reinitialize texture if necessary
+    bool bTargetReset = false;
     if (!Texture || Texture->GetPixelFormat() != requiredPF) {
       Texture = UTexture2D::CreateTransient(VideoSizeX, VideoSizeY, requiredPF);
       Texture->UpdateResource();
+      bTargetReset = true;
     }
 
     // check if we should resize
     if (m.cols != Texture->GetSizeX() || m.rows != Texture->GetSizeY()) {
       if (Resize) {
-        cv::resize(m, m, cv::Size{Texture->GetSizeX(), Texture->GetSizeY()});
+        // the resize happens during the conversion to the staging buffer
         VideoSizeX = Texture->GetSizeX();
         VideoSizeY = Texture->GetSizeY();
       } else {
@@ -259,12 +484,31 @@ void UCVUMat::ToTexture(UTexture2D *&Texture, bool Resize) {
       }
     }
 
-    size_t requiredDataSize{m.total() * targetElementSize};
-    uint32_t requiredDataWrapType{CV_8UC(targetElementSize)};
+    // Partial updates are only meaningful if the previous contents of the texture are still valid
+    TArray<FIntRect> ChangedTiles;
+    const bool bResize = m.cols != static_cast<int>(VideoSizeX) ||
+                         m.rows != static_cast<int>(VideoSizeY);
+    const TArray<FIntRect> *DirtyRects = bTargetReset ? nullptr : Regions;
+    const bool bTrackChanges = bUploadChangedTilesOnly && !Regions && !bResize;
+    if (bTrackChanges) {
+      DirtyRects = GetChangedTiles(Texture, bTargetReset, ChangedTiles);
+    }
+    // The baseline is only valid once this upload went through
+    PreviousUploadTarget = nullptr;
+
+    size_t requiredDataSize{size_t(VideoSizeX) * VideoSizeY * targetElementSize};
+    uint32_t requiredDataWrapType{
+        static_cast<uint32_t>(requiredConversion != -1 ? CV_8UC(targetElementSize) : m.type())};
     auto resource = static_cast<FTexture2DResource *>(Texture->Resource);
 
     detail::ConvertAndUpload(requiredDataSize, requiredConversion, m, requiredDataWrapType,
-                             resource, targetElementSize, VideoSizeX, VideoSizeY);
+                             resource, targetElementSize, VideoSizeX, VideoSizeY, DirtyRects);
+
+    const uint64 Serial = detail::RecordUpload(Texture);
+    if (bTrackChanges) {
+      PreviousUploadTarget = Texture;
+      PreviousUploadSerial = Serial;
+    }
   } catch (cv::Exception &e) {
     UE_LOG(OpenCV, Warning, TEXT("Function %s: Caught OpenCV Exception: %s"), TEXT(__FUNCTION__),
            UTF8_TO_TCHAR(e.what()));
@@ -272,122 +516,73 @@ void UCVUMat::ToTexture(UTexture2D *&Texture, bool Resize) {
 }
 
 void UCVUMat::ToVolumeTexture(UVolumeTexture *&VolumeTexture) {
-  if (m.total() == 0) {
-    UE_LOG(OpenCV, Error, TEXT("Cannot upload an empty matrix!"));
+  detail::FCVUploadFormat Format;
+  if (!detail::ValidateVolume(m, Format)) {
     return;
   }
-  if (m.channels() != 1) {
-    UE_LOG(OpenCV, Error, TEXT("Channel mismatch: Volume has to be single-channel!"));
-    return;
+
+  try {
+    const FIntVector Dimensions{m.size[2], m.size[1], m.size[0]};
+    detail::UploadVolume(VolumeTexture, Dimensions, Format, VolumeMipFilter,
+                         [this](cv::Mat &Dst) {
+                           detail::CopyVolumeVoxels(m.getMat(cv::ACCESS_READ), Dst);
+                         });
+  } catch (cv::Exception &e) {
+    UE_LOG(OpenCV, Warning, TEXT("Function %s: Caught OpenCV Exception: %s"), TEXT(__FUNCTION__),
+           UTF8_TO_TCHAR(e.what()));
   }
-  if (m.dims != 3) {
-    UE_LOG(OpenCV, Error, TEXT("Dimensionality mismatch: cv::UMat has to contain a 3D image!"));
+}
+
+void UCVUMat::ToVolumeTextureWindowed(UVolumeTexture *&VolumeTexture, float WindowCenter,
+                                      float WindowWidth) {
+  detail::FCVUploadFormat Format;
+  if (!detail::ValidateVolume(m, Format)) {
     return;
   }
-  if (m.elemSize() != 1) {
-    UE_LOG(OpenCV, Error, TEXT("Pixel size mismatch: cv::UMat has to be 1 byte per pixel!"));
+
+  try {
+    const FIntVector Dimensions{m.size[2], m.size[1], m.size[0]};
+    const cv::Mat Src = m.getMat(cv::ACCESS_READ);
+
+    // Quantise straight into the mip memory, there is no intermediate 8-bit volume
+    detail::UploadVolume(VolumeTexture, Dimensions, {PF_G8, -1, 1}, VolumeMipFilter,
+                         [&](cv::Mat &Dst) {
+                           detail::WindowLevelToU8(Src, Dst, WindowCenter, WindowWidth);
+                         });
+  } catch (cv::Exception &e) {
+    UE_LOG(OpenCV, Warning, TEXT("Function %s: Caught OpenCV Exception: %s"), TEXT(__FUNCTION__),
+           UTF8_TO_TCHAR(e.what()));
+  }
+}
+
+void UCVUMat::ToVolumeTextureSlices(UVolumeTexture *&VolumeTexture, int32 ZBegin, int32 ZEnd) {
+  detail::FCVUploadFormat Format;
+  if (!detail::ValidateVolume(m, Format)) {
     return;
   }
 
   const FIntVector Dimensions{m.size[2], m.size[1], m.size[0]};
-  const int TotalSize = Dimensions.X * Dimensions.Y * Dimensions.Z;
 
-  // Create a new texture if none was specified
-  if (!VolumeTexture) {
-    VolumeTexture = NewObject<UVolumeTexture>();
+  // Slice updates need an existing RHI texture of the same size and format
+  if (!detail::CanUpdateVolumeInPlace(VolumeTexture, Dimensions, Format.PixelFormat)) {
+    UE_LOG(OpenCV, Log, TEXT("Volume texture does not match, uploading the whole volume."));
+    ToVolumeTexture(VolumeTexture);
+    return;
   }
 
-  FTexture2DMipMap *mip;
-
-  // TODO If an existing mip is selected and updated (through mip->BulkData), the change will
-  // not have an effect in packaged builds. Only newly created mips work. Investigate!
-
-  // If existing texture is not suitable, create a new one
-  /*if (VolumeTexture->GetSizeX() != Dimensions.X || VolumeTexture->GetSizeY() != Dimensions.Y ||
-      VolumeTexture->GetSizeZ() != Dimensions.Z || VolumeTexture->GetPixelFormat() != PF_G8 ||
-      !VolumeTexture->PlatformData || !VolumeTexture->PlatformData->Mips.IsValidIndex(0))
-  */
-  {
-    UE_LOG(OpenCV, Warning, TEXT("Created a new texture!"));
-
-    // Set volume texture parameters.
-
-    VolumeTexture->NeverStream = false;
-    VolumeTexture->SRGB = false;
-    VolumeTexture->bUAVCompatible = true;  // this requires the custom built engine
-
-    // Set PlatformData parameters (create PlatformData if it doesn't exist)
-    if (!VolumeTexture->PlatformData) {
-      VolumeTexture->PlatformData = new FTexturePlatformData();
-    }
-
-    VolumeTexture->PlatformData->PixelFormat = PF_G8;
-    VolumeTexture->PlatformData->SizeX = Dimensions.X;
-    VolumeTexture->PlatformData->SizeY = Dimensions.Y;
-    VolumeTexture->PlatformData->NumSlices = Dimensions.Z;
-
-    // If the texture already has MIPs in it, destroy and free them (Empty() calls destructors and
-    // frees space).
-    if (VolumeTexture->PlatformData->Mips.Num() != 0) {
-      VolumeTexture->PlatformData->Mips.Empty();
-    }
-
-    mip = new FTexture2DMipMap();
-    // Add the new MIP.
-    VolumeTexture->PlatformData->Mips.Add(mip);
-
-    mip->SizeX = Dimensions.X;
-    mip->SizeY = Dimensions.Y;
-    mip->SizeZ = Dimensions.Z;
-
-#if !UPDATE_VOLUME_THROUGH_MIPS
-    // Update the resource to make sure the buffer size matches
-    VolumeTexture->UpdateResource();
-#endif
+  ZBegin = FMath::Clamp(ZBegin, 0, Dimensions.Z);
+  ZEnd = FMath::Clamp(ZEnd, ZBegin, Dimensions.Z);
+  if (ZBegin == ZEnd) {
+    return;
   }
-  // Doesn't work due to the above TODO...
-  //  else {
-  //	mip = VolumeTexture->PlatformData->Mips[0];
-  //  }
-
-#if UPDATE_VOLUME_THROUGH_MIPS
-  mip->BulkData.Lock(EBulkDataLockFlags::LOCK_READ_WRITE);
-
-  const int sz[3]{m.size[0], m.size[1], m.size[2]};
-  uint8 *ByteArray = (uint8 *)mip->BulkData.Realloc(TotalSize);
-  cv::Mat wrap{3, sz, CV_8UC1, ByteArray};
-  m.copyTo(wrap);
-  mip->BulkData.Unlock();
-  VolumeTexture->UpdateResource();
-#else
-  // This version of updating the texture requires a minor customization of the engine source code
-  // to allow access to the Texture3D RHI object, but might be more efficient (not confirmed)
-  struct FUpdateTextureRegions3DData {
-    FHackedVolumeTextureResource *TextureResource;
-    FUpdateTextureRegion3D Region;
-    uint32 SrcRowPitch;
-    uint32 SrcDepthPitch;
-    cv::Mat SrcData;
-  };
-
-  auto TextureResource = (FHackedVolumeTextureResource *)VolumeTexture->Resource;
 
-  uint32 SrcRowPitch = static_cast<uint32>(Dimensions.X);
-  uint32 SrcDepthPitch = static_cast<uint32>(Dimensions.X * Dimensions.Y);
-  auto RegionData = new FUpdateTextureRegions3DData{
-      TextureResource,
-      FUpdateTextureRegion3D(0, 0, 0, 0, 0, 0, Dimensions.X, Dimensions.Y, Dimensions.Z),
-      SrcRowPitch, SrcDepthPitch, m.getMat(cv::ACCESS_READ).clone()};
-
-  ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(
-      UpdateTextureRegionsData, FUpdateTextureRegions3DData *, RegionData, RegionData, {
-        RHIUpdateTexture3D(RegionData->TextureResource->GetTextureRHI(), 0, RegionData->Region,
-                           RegionData->SrcRowPitch, RegionData->SrcDepthPitch,
-                           RegionData->SrcData.data);
-
-        delete RegionData;
-      });
-#endif
+  try {
+    const cv::Range Slab[3]{{ZBegin, ZEnd}, {0, Dimensions.Y}, {0, Dimensions.X}};
+    detail::UpdateVolumeBox(VolumeTexture, m, m.getMat(cv::ACCESS_READ), Slab);
+  } catch (cv::Exception &e) {
+    UE_LOG(OpenCV, Warning, TEXT("Function %s: Caught OpenCV Exception: %s"), TEXT(__FUNCTION__),
+           UTF8_TO_TCHAR(e.what()));
+  }
 }
 
 void UCVUMat::FromTexture2D(UTexture2D *Texture, UCVUMat *&Mat) {
@@ -406,27 +601,19 @@ void UCVUMat::FromTexture2D(UTexture2D *Texture, UCVUMat *&Mat) {
     return;
   }
 
-  cv::Mat m = Mat->m.getMat(cv::ACCESS_RW);
-
-  int cvFormat{-1};
-  if (Texture->PlatformData->PixelFormat == PF_G8) {
-    cvFormat = CV_8UC1;
-  } else if (Texture->PlatformData->PixelFormat == PF_B8G8R8A8 ||
-             Texture->PlatformData->PixelFormat == PF_R8G8B8A8) {
-    cvFormat = CV_8UC4;
-  } else if (Texture->PlatformData->PixelFormat == PF_FloatRGB) {
-    cvFormat = CV_32FC3;
-  } else if (Texture->PlatformData->PixelFormat == PF_FloatRGBA) {
-    cvFormat = CV_32FC4;
-  }
+  const int32 cvFormat = detail::PixelFormatToCvType(Texture->PlatformData->PixelFormat);
 
   if (!ensure(cvFormat != -1)) {
     UE_LOG(OpenCV, Error, TEXT("Given texture has a currently unsupported format!"));
     return;
   }
 
-  // auto &mip = texture->PlatformData->Mips[0];
-  // void *memoryBuffer = mip.BulkData.Lock(EBulkDataLockFlags::LOCK_READ_WRITE);
+  const int32 SizeX = Texture->GetSizeX();
+  const int32 SizeY = Texture->GetSizeY();
+
+  // create() is a no-op if the matrix already has the right size and type, so repeated readbacks
+  // of the same texture write into the same memory
+  Mat->m.create(SizeY, SizeX, cvFormat);
 
   struct FCopyBufferData {
     UTexture2D *Texture;
@@ -437,7 +624,7 @@ void UCVUMat::FromTexture2D(UTexture2D *Texture, UCVUMat *&Mat) {
   using FCommandDataPtr = TSharedPtr<FCopyBufferData, ESPMode::ThreadSafe>;
   FCommandDataPtr CommandData = MakeShared<FCopyBufferData, ESPMode::ThreadSafe>();
   CommandData->Texture = Texture;
-  CommandData->Mat = m;
+  CommandData->Mat = Mat->m.getMat(cv::ACCESS_WRITE);
   CommandData->cvFormat = cvFormat;
 
   auto Future = CommandData->Promise.GetFuture();
@@ -449,10 +636,9 @@ void UCVUMat::FromTexture2D(UTexture2D *Texture, UCVUMat *&Mat) {
         uint8 *memoryBuffer = (uint8 *)RHILockTexture2D(
             Texture2DRHI, 0, EResourceLockMode::RLM_ReadOnly, DestPitch, false);
 
-        int SizeX = CommandData->Texture->GetSizeX();
-        int SizeY = CommandData->Texture->GetSizeY();
-
-        cv::Mat memoryWrapper(SizeY, SizeX, CommandData->cvFormat, memoryBuffer);
+        // The locked rows may be padded, so wrap the memory with the actual row pitch
+        cv::Mat memoryWrapper(CommandData->Mat.rows, CommandData->Mat.cols,
+                              CommandData->cvFormat, memoryBuffer, DestPitch);
         memoryWrapper.copyTo(CommandData->Mat);
         RHIUnlockTexture2D(Texture2DRHI, 0, false);
         CommandData->Promise.SetValue();
@@ -461,12 +647,14 @@ void UCVUMat::FromTexture2D(UTexture2D *Texture, UCVUMat *&Mat) {
   // wait until render thread operation completes
   Future.Get();
 
-  Mat->m = CommandData->Mat.getUMat(cv::ACCESS_RW);
+  // Unmap the destination, the data was written straight into Mat->m
+  CommandData->Mat.release();
 }
 
 void UCVUMat::FromVolumeTexture(UVolumeTexture *Texture, UCVUMat *&Mat) {
   if (!ensure(Texture != nullptr)) {
     UE_LOG(OpenCV, Error, TEXT("The given texture is empty!"));
+    return;
   }
 
   if (Mat == nullptr) {
@@ -479,42 +667,54 @@ void UCVUMat::FromVolumeTexture(UVolumeTexture *Texture, UCVUMat *&Mat) {
     return;
   }
 
-  cv::Mat m = Mat->m.getMat(cv::ACCESS_RW);
-
-  int cvFormat{-1};
-  if (Texture->PlatformData->PixelFormat == PF_G8 || Texture->PlatformData->PixelFormat == PF_A8) {
-    cvFormat = CV_8UC1;
-  } else if (Texture->PlatformData->PixelFormat == PF_B8G8R8A8 ||
-             Texture->PlatformData->PixelFormat == PF_R8G8B8A8) {
-    cvFormat = CV_8UC4;
-  } else if (Texture->PlatformData->PixelFormat == PF_FloatRGB) {
-    cvFormat = CV_32FC3;
-  } else if (Texture->PlatformData->PixelFormat == PF_FloatRGBA) {
-    cvFormat = CV_32FC4;
-  }
-
+  const int cvFormat = detail::PixelFormatToCvType(Texture->PlatformData->PixelFormat);
   if (!ensure(cvFormat != -1)) {
     UE_LOG(OpenCV, Error, TEXT("Given texture has a currently unsupported format!"));
     return;
   }
 
   auto &mip = Texture->PlatformData->Mips[0];
-  void *memoryBuffer = mip.BulkData.Lock(EBulkDataLockFlags::LOCK_READ_WRITE);
+  const void *memoryBuffer = mip.BulkData.LockReadOnly();
 
   if (ensure(memoryBuffer != nullptr)) {
-    int32 SizeX = Texture->GetSizeX();
-    int32 SizeY = Texture->GetSizeY();
-    int32 SizeZ = Texture->GetSizeZ();
-
-    cv::Mat memoryWrapper({SizeZ, SizeY, SizeX}, cvFormat, memoryBuffer);
-    memoryWrapper.copyTo(m);
+    const int sz[3]{Texture->GetSizeZ(), Texture->GetSizeY(), Texture->GetSizeX()};
+
+    try {
+      const cv::Mat memoryWrapper(3, sz, cvFormat, const_cast<void *>(memoryBuffer));
+      if (Texture->PlatformData->PixelFormat == PF_R16F) {
+        // 16S is only the storage of the half floats, the values are returned as floats
+        cv::Mat Float;
+        cv::convertFp16(memoryWrapper, Float);
+        Float.copyTo(Mat->m);
+      } else {
+        memoryWrapper.copyTo(Mat->m);
+      }
+    } catch (cv::Exception &e) {
+      UE_LOG(OpenCV, Warning, TEXT("Function %s: Caught OpenCV Exception: %s"),
+             TEXT(__FUNCTION__), UTF8_TO_TCHAR(e.what()));
+    }
   } else {
     UE_LOG(OpenCV, Error,
-           TEXT("Could not lock Mip 0. Apparently this texture does not have CPU backing."));
+           TEXT("Could not lock Mip 0. Apparently this texture does not have CPU backing, ")
+               TEXT("use the async variant to read it back from the GPU."));
   }
   mip.BulkData.Unlock();
+}
+
+FCVStagingPoolStats UCVUMat::GetStagingPoolStats() {
+  const FCVStagingBufferPool &Pool = FCVStagingBufferPool::Get();
+
+  FCVStagingPoolStats Stats;
+  Stats.Hits = static_cast<int32>(Pool.GetNumHits());
+  Stats.Misses = static_cast<int32>(Pool.GetNumMisses());
+  Stats.PooledKiloBytes = static_cast<int32>(Pool.GetPooledBytes() / 1024);
+  Stats.MaxPooledMegaBytes = static_cast<int32>(Pool.GetMaxPooledBytes() / (1024 * 1024));
+  return Stats;
+}
 
-  Mat->m = m.getUMat(cv::ACCESS_RW);
+void UCVUMat::SetStagingPoolLimit(int32 MaxPooledMegaBytes) {
+  FCVStagingBufferPool::Get().SetMaxPooledBytes(
+      static_cast<SIZE_T>(FMath::Max(MaxPooledMegaBytes, 0)) * 1024 * 1024);
 }
 
 //
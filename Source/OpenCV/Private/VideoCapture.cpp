@@ -3,11 +3,10 @@
 
 #include "VideoCapture.h"
 
+#include "CVCaptureWorker.h"
+#include "CVLatencyTracker.h"
 #include "OpenCV_Common.h"
 
-#include "Runtime/Core/Public/HAL/Runnable.h"
-#include "Runtime/Core/Public/HAL/RunnableThread.h"
-
 THIRD_PARTY_INCLUDES_START
 #include <opencv2/imgproc.hpp>
 THIRD_PARTY_INCLUDES_END
@@ -23,47 +22,91 @@ AVideoCapture::AVideoCapture() {
   // Initialize OpenCV and webcam properties
   CameraID = 0;
   VideoFile = 0;
-  OperationMode = 0;
   RefreshRate = 30;
   isStreamOpen = false;
   VideoSize = FVector2D(0, 0);
   ShouldResize = false;
   ResizeDimensions = FVector2D(320, 240);
   RefreshTimer = 0.0f;
+  ParallelMJPEGDecode = false;
+  MaxDecodesInFlight = 4;
+  PlaybackPacing = ECVPlaybackPacing::RefreshRate;
+  EnableScrubbing = false;
+  FrameCacheSize = 32;
+  MaxForwardGrabFrames = 0;
+  FrameCount = 0;
+  SkippedFrames = 0;
+  FrameQueuePolicy = ECVFrameQueuePolicy::LatestOnly;
+  FrameQueueCapacity = 3;
+  DroppedFrames = 0;
+  QueueDepth = 0;
+  FramePoolSize = 4;
+  ExplicitFrameRelease = false;
+  FramesInUse = 0;
   stream = nullptr;
   size = nullptr;
   frame = nullptr;
+  CaptureWorker = nullptr;
 }
 
 // Called when the game starts or when spawned
 void AVideoCapture::BeginPlay() {
   Super::BeginPlay();
 
-  frame = NewObject<UCVUMat>();
+  // All frame objects are created up front, capturing never creates UObjects
+  FramePool.Reset(FramePoolSize);
+  FreeFrames.Reset(FramePoolSize);
+  for (int32 i = 0; i < FMath::Max(FramePoolSize, 2); ++i) {
+    FramePool.Add(NewObject<UCVUMat>(this));
+    FreeFrames.Add(i);
+  }
+  frame = nullptr;
+  FramesInUse = 0;
+
   size = new cv::Size(ResizeDimensions.X, ResizeDimensions.Y);
 
-  // Open the stream
-  if (CameraID >= 0) {
-    stream = new cv::VideoCapture(CameraID);
+  // Open and read the stream on the capture thread
+  FCVCaptureSettings Settings;
+  Settings.CameraID = CameraID;
+  Settings.VideoFile = VideoFile;
+  Settings.bResize = ShouldResize;
+  Settings.ResizeTo = *size;
+  Settings.ProcessingChain = ProcessingChain;
+  Settings.FrameRate = RefreshRate;
+  Settings.bParallelMJPEG = ParallelMJPEGDecode;
+  Settings.MaxDecodesInFlight = MaxDecodesInFlight;
+  Settings.bPaceByTimestamps = PlaybackPacing == ECVPlaybackPacing::FileTimestamps;
+  Settings.bScrubbing = EnableScrubbing;
+  Settings.FrameCacheSize = FrameCacheSize;
+  Settings.MaxForwardGrab = MaxForwardGrabFrames;
+  Settings.QueuePolicy = FrameQueuePolicy;
+  Settings.QueueCapacity = FrameQueueCapacity;
+
+  LatencyTracker = MakeShared<FCVLatencyTracker, ESPMode::ThreadSafe>();
+  CaptureWorker = new FCVCaptureWorker(Settings);
+  stream = &CaptureWorker->GetCapture();
+  CaptureWorker->Start();
+}
 
-  } else {
-    std::string file = std::string(TCHAR_TO_UTF8(*VideoFile));
-    stream = new cv::VideoCapture(file);
-  }
+void AVideoCapture::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+  Super::EndPlay(EndPlayReason);
 
-  if (stream->isOpened()) {
-    // Initialize stream
-    isStreamOpen = true;
-    UpdateFrame();
-    ResetTexture();
+  delete CaptureWorker;
+  CaptureWorker = nullptr;
+  LatencyTracker.Reset();
+  stream = nullptr;
+  isStreamOpen = false;
 
-    //// Do first frame
-    UpdateTexture();
-    OnVideoFrameUpdated();
-    On_VideoFrameUpdated.Broadcast(frame);
-  } else {
-    UE_LOG(OpenCV, Warning, TEXT("Could not open Stream %s "), *VideoFile);
+  delete size;
+  size = nullptr;
+
+  for (UCVUMat* Frame : FramePool) {
+    Frame->m.release();
   }
+  FramePool.Reset();
+  FreeFrames.Reset();
+  frame = nullptr;
+  FramesInUse = 0;
 }
 
 void AVideoCapture::ResetTexture() {
@@ -82,25 +125,77 @@ void AVideoCapture::ResetTexture() {
 void AVideoCapture::Tick(float DeltaTime) {
   Super::Tick(DeltaTime);
 
-  RefreshTimer += DeltaTime;
+  if (!CaptureWorker) return;
+  isStreamOpen = CaptureWorker->IsOpen();
 
-  if (isStreamOpen && RefreshTimer >= 1.0f / RefreshRate) {
-    RefreshTimer -= 1.0f / RefreshRate;
-    UpdateFrame();
+  // One frame per tick, with a FIFO policy the rest stays queued for the next ticks
+  const bool bNewFrame = UpdateFrame();
+  DroppedFrames = CaptureWorker->GetNumDroppedFrames();
+  QueueDepth = CaptureWorker->GetQueueDepth();
+  SkippedFrames = CaptureWorker->GetNumSkippedFrames();
+  FrameCount = static_cast<int32>(CaptureWorker->GetFrameCount());
+
+  if (bNewFrame) {
+    if (VideoSize != FVector2D(frame->m.cols, frame->m.rows)) {
+      ResetTexture();
+    }
     UpdateTexture();
     OnVideoFrameUpdated();
     On_VideoFrameUpdated.Broadcast(frame);
   }
+
+  LatencyTracker->Update(FrameLatency, FrameLatencyP50, FrameLatencyP95, FrameLatencyP99);
 }
 
-void AVideoCapture::UpdateFrame() {
-  if (stream->isOpened()) {
-    stream->read(frame->m);
-    if (ShouldResize) {
-      cv::resize(frame->m, frame->m, *size);
-    }
-  } else {
-    isStreamOpen = false;
+bool AVideoCapture::UpdateFrame() {
+  // Without a free frame object the captured frames wait in the queue
+  if (!CaptureWorker || (ExplicitFrameRelease && FreeFrames.Num() == 0)) {
+    return false;
+  }
+
+  FCVCaptureFrame Frame;
+  if (!CaptureWorker->PopFrame(Frame)) {
+    return false;
+  }
+  if (!ExplicitFrameRelease && frame && !FreeFrames.Contains(FramePool.Find(frame))) {
+    ReleaseFrame(frame);
+  }
+
+  // The frame only references the capture buffer, which is reused once the frame is released
+  frame = FramePool[FreeFrames.Pop(false)];
+  frame->m = Frame.Image;
+  LatencyTracker->BeginUpload(Frame.Timestamps);
+  FramesInUse = FramePool.Num() - FreeFrames.Num();
+  return true;
+}
+
+void AVideoCapture::ReleaseFrame(UCVUMat* ReleasedFrame) {
+  const int32 Index = FramePool.Find(ReleasedFrame);
+  if (Index == INDEX_NONE || FreeFrames.Contains(Index)) {
+    UE_LOG(OpenCV, Warning, TEXT("%s: Released a frame that is not in use!"), *GetName());
+    return;
+  }
+
+  ReleasedFrame->m.release();
+  FreeFrames.Add(Index);
+  FramesInUse = FramePool.Num() - FreeFrames.Num();
+}
+
+void AVideoCapture::SeekToFrame(int32 FrameIndex) {
+  if (CaptureWorker) {
+    CaptureWorker->SeekToFrame(FrameIndex);
+  }
+}
+
+void AVideoCapture::SeekToTime(float Seconds) {
+  if (CaptureWorker) {
+    CaptureWorker->SeekToTime(Seconds);
+  }
+}
+
+void AVideoCapture::SetPaused(bool Paused) {
+  if (CaptureWorker) {
+    CaptureWorker->SetPaused(Paused);
   }
 }
 
@@ -108,6 +203,7 @@ void AVideoCapture::UpdateTexture() {
   if (!frame->m.empty()) {
     if (RTVideoTexture) {
       frame->ToRenderTarget(RTVideoTexture, true);
+      FCVLatencyTracker::EndUpload(LatencyTracker.ToSharedRef());
     }
   }
 }
@@ -0,0 +1,114 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+
+#include "Classes/CVCaptureTypes.h"
+#include "Classes/UCVUMat.h"
+
+#include "CVCaptureManager.generated.h"
+
+class FQueuedThreadPool;
+struct FCVManagedStream;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FCVFrameSetDelegate, const FCVFrameSet&, frameSet);
+
+/**
+ * Captures several streams at once and delivers their frames as synchronised sets.
+ * All streams are read on one shared thread pool, each frame is timestamped when it is grabbed.
+ * Every tick, the frames of all streams are matched by nearest capture time; a set is delivered
+ * once every stream has a frame within SyncTolerance of the others. Frames that cannot be part
+ * of any set anymore are dropped.
+ */
+UCLASS()
+class OPENCV_API ACVCaptureManager : public AActor {
+  GENERATED_BODY()
+
+public:
+  ACVCaptureManager();
+
+  virtual void Tick(float DeltaSeconds) override;
+
+protected:
+  // Opens all streams on the thread pool
+  virtual void BeginPlay() override;
+
+  // Stops all streams and the thread pool
+  virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+  // Blueprint Event called every time a new frame set was delivered
+  UFUNCTION(BlueprintImplementableEvent, Category = "OpenCV|VideoCapture")
+  void OnFrameSetUpdated();
+
+  // Called with the most recent synchronised frame set. The frame objects are reused for the next
+  // set, copy the matrices to keep them.
+  UPROPERTY(BlueprintAssignable, Category = "OpenCV|VideoCapture")
+  FCVFrameSetDelegate On_FrameSetUpdated;
+
+public:
+  // The streams to capture
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  TArray<FCVCaptureStreamConfig> Streams;
+
+  // Number of threads reading the streams, 0 for one per stream. With fewer threads than streams,
+  // each thread reads the streams in turns one frame at a time.
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture",
+            meta = (ClampMin = "0"))
+  int32 NumWorkerThreads;
+
+  // Maximum difference in seconds between the capture times of the frames of a set
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture",
+            meta = (ClampMin = "0"))
+  float SyncTolerance;
+
+  // The maximum rate at which frames are read from each stream (in frames per second)
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  float RefreshRate;
+
+  // If the frames should be resized on the capture threads
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  bool ShouldResize;
+
+  // The targeted resize width and height (width, height)
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  FVector2D ResizeDimensions;
+
+  // Maximum number of frames per stream waiting to be matched
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture",
+            meta = (ClampMin = "1"))
+  int32 FrameQueueCapacity;
+
+  // The most recent synchronised frame set
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  FCVFrameSet FrameSet;
+
+  // Number of frame sets that were matched since the streams were opened
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  int32 MatchedSets;
+
+  // Number of frames that could not be matched to a set
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  int32 UnmatchedFrames;
+
+  // Number of streams that are currently open
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  int32 OpenStreams;
+
+protected:
+  // Matches the pending frames of all streams, returns true if FrameSet was updated
+  bool MatchFrameSets();
+
+  // One frame object per stream that the delivered sets point to
+  UPROPERTY()
+  TArray<UCVUMat*> StreamFrames;
+
+  TArray<FCVManagedStream*> ManagedStreams;
+  FQueuedThreadPool* ThreadPool;
+
+  // FPlatformTime::Seconds() at BeginPlay, capture times are reported relative to this
+  double StartTime;
+};
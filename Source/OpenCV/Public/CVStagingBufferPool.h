@@ -0,0 +1,74 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "Misc/ScopeLock.h"
+
+/**
+ * A block of staging memory checked out from FCVStagingBufferPool. Capacity is the rounded-up
+ * bucket size and may be larger than the requested size.
+ */
+struct FCVStagingBuffer {
+  uint8* Data{nullptr};
+  SIZE_T Capacity{0};
+
+  bool IsValid() const { return Data != nullptr; }
+};
+
+/**
+ * Thread-safe, size-bucketed pool for the CPU staging memory used by the texture uploads.
+ * Buffers are acquired on the game thread and released by the render command once the upload has
+ * been submitted, so with a constant frame size the steady state does not allocate at all.
+ *
+ * Requested sizes are rounded up to a quarter of their power of two, i.e. at most 25% of a buffer
+ * is wasted. Released buffers are kept until the pooled memory would exceed the high-water mark,
+ * after which they are freed immediately.
+ */
+class OPENCV_API FCVStagingBufferPool {
+public:
+  static FCVStagingBufferPool& Get();
+
+  FCVStagingBufferPool();
+  ~FCVStagingBufferPool();
+
+  /** Check out a buffer of at least Size bytes. The memory is 64-byte aligned. */
+  FCVStagingBuffer Acquire(SIZE_T Size);
+
+  /** Return a buffer to the pool (or free it if the pool is full). Resets Buffer. */
+  void Release(FCVStagingBuffer& Buffer);
+
+  /** Free all buffers that are currently held by the pool */
+  void Trim();
+
+  void SetMaxPooledBytes(SIZE_T MaxBytes);
+  SIZE_T GetMaxPooledBytes() const;
+
+  /** Number of bytes currently held by the pool (not including checked out buffers) */
+  SIZE_T GetPooledBytes() const;
+
+  /** Number of Acquire() calls that were served from the pool */
+  int64 GetNumHits() const { return Hits.GetValue(); }
+  /** Number of Acquire() calls that had to allocate */
+  int64 GetNumMisses() const { return Misses.GetValue(); }
+  void ResetStats();
+
+private:
+  static SIZE_T GetBucketSize(SIZE_T Size);
+
+  // Trims the pool down to MaxPooledBytes, needs to be called with Mutex held
+  void TrimToLimit();
+
+  mutable FCriticalSection Mutex;
+
+  // Free buffers, keyed by bucket size
+  TMap<SIZE_T, TArray<uint8*>> Buckets;
+
+  SIZE_T PooledBytes;
+  SIZE_T MaxPooledBytes;
+
+  FThreadSafeCounter64 Hits;
+  FThreadSafeCounter64 Misses;
+};
@@ -0,0 +1,86 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "Containers/Ticker.h"
+
+THIRD_PARTY_INCLUDES_START
+#include <opencv2/core.hpp>
+THIRD_PARTY_INCLUDES_END
+
+class UTexture;
+class UVolumeTexture;
+
+/**
+ * Non-blocking readback of 2D textures and render targets into cv::UMats.
+ *
+ * Each request copies the texture into one slot of a small ring of CPU-readable staging textures
+ * on the render thread. The staging texture is only mapped a few frames later, once the copy has
+ * certainly finished on the GPU, so neither the game thread nor the render thread ever wait for
+ * the GPU. The result of frame N is delivered on the game thread in frame N + ReadbackLatency.
+ */
+class OPENCV_API FCVTextureReadback {
+public:
+  /** Called on the game thread. Result is empty if bSuccess is false. */
+  using FOnReadbackComplete = TFunction<void(bool bSuccess, cv::UMat Result)>;
+
+  static FCVTextureReadback& Get();
+
+  FCVTextureReadback();
+  ~FCVTextureReadback();
+
+  /**
+   * Request a readback of Texture (UTexture2D or UTextureRenderTarget2D). Returns false if all
+   * slots of the ring are in flight, in which case OnComplete is not called.
+   */
+  bool Enqueue(UTexture* Texture, FOnReadbackComplete OnComplete);
+
+  /** Like Enqueue, but returns a future. The future holds an empty matrix on failure. */
+  TFuture<cv::UMat> Enqueue(UTexture* Texture);
+
+  /**
+   * Request a readback of the GPU contents of a volume texture into a 3D matrix, for volumes
+   * without CPU backing (e.g. written by compute shaders). Every frame, SlicesPerFrame slices
+   * are copied by a compute shader into a 2D texture and from there into a staging texture,
+   * which is mapped ReadbackLatency frames later like the 2D slots, so no thread waits for the
+   * GPU.
+   * Needs SM5. PF_G8, PF_G16, PF_R32_FLOAT, PF_FloatRGBA and PF_A32B32G32R32F volumes give 8U, 16U,
+   * 32F, 16SC4 (half floats, see cv::convertFp16) and 32FC4 matrices, PF_R16F volumes give 32F
+   * matrices. Other formats (e.g. compressed or BGRA8) are not supported.
+   * Returns false if the texture cannot be read back, in which case OnComplete is not called.
+   */
+  bool EnqueueVolume(UVolumeTexture* Texture, FOnReadbackComplete OnComplete,
+                     int32 SlicesPerFrame = 16);
+
+  /** Number of staging textures, i.e. the maximum number of readbacks in flight */
+  void SetRingSize(int32 NumSlots);
+  int32 GetRingSize() const { return Slots.Num(); }
+
+  /** Number of frames between the copy and mapping the staging texture */
+  void SetReadbackLatency(int32 NumFrames) { ReadbackLatency = FMath::Max(NumFrames, 1); }
+
+  int32 GetNumInFlight() const;
+
+private:
+  struct FSlot;
+  using FSlotPtr = TSharedPtr<FSlot, ESPMode::ThreadSafe>;
+  struct FSlabSlot;
+  using FSlabSlotPtr = TSharedPtr<FSlabSlot, ESPMode::ThreadSafe>;
+  struct FVolumeJob;
+  using FVolumeJobPtr = TSharedPtr<FVolumeJob, ESPMode::ThreadSafe>;
+
+  bool Tick(float DeltaTime);
+
+  // Maps the finished slabs of a volume readback and copies the next one, returns true once all
+  // slabs have arrived
+  bool TickVolumeJob(const FVolumeJobPtr& Job);
+  void StartTicking();
+
+  TArray<FSlotPtr> Slots;
+  TArray<FVolumeJobPtr> VolumeJobs;
+  int32 ReadbackLatency;
+  FDelegateHandle TickHandle;
+};
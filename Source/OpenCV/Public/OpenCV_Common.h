@@ -4,6 +4,10 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
 
 // Declare our own log category
 DECLARE_LOG_CATEGORY_EXTERN(OpenCV, Log, All);
+
+// Cycle counters and latencies of the capture and upload pipeline ("stat OpenCV")
+DECLARE_STATS_GROUP(TEXT("OpenCV"), STATGROUP_OpenCV, STATCAT_Advanced);
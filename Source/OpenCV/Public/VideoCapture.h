@@ -9,6 +9,7 @@
 #include "Runtime/Engine/Classes/Engine/Texture2D.h"
 #include "Runtime/Engine/Classes/Engine/TextureRenderTarget2D.h"
 
+#include "Classes/CVCaptureTypes.h"
 #include "Classes/UCVUMat.h"
 
 THIRD_PARTY_INCLUDES_START
@@ -19,6 +20,8 @@ THIRD_PARTY_INCLUDES_END
 #include "VideoCapture.generated.h"
 
 class AVideoCapture;
+class FCVCaptureWorker;
+class FCVLatencyTracker;
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FVideoFrameDelegate, UCVUMat*, newFrame);
 
@@ -37,6 +40,9 @@ protected:
   // Called when the game starts or when spawned
   virtual void BeginPlay() override;
 
+  // Stops the capture thread
+  virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
   // Called whenever the texture dimensions/format changes
   void ResetTexture();
 
@@ -61,9 +67,10 @@ public:
   UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
   FString VideoFile;
 
-  // The operation that will be applied to every frame
+  // Stages that are applied to every frame in order, on the capture thread before the frame is
+  // published. Changes take effect when the stream is opened.
   UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
-  int32 OperationMode;
+  TArray<FCVProcessingStage> ProcessingChain;
 
   // If the webcam images should be resized every frame
   UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
@@ -73,24 +80,133 @@ public:
   UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
   FVector2D ResizeDimensions;
 
-  // The rate at which the color data array and video texture is updated (in frames per second)
+  // The maximum rate at which frames are read from the stream (in frames per second)
   UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
   float RefreshRate;
 
-  // The refresh timer
+  // Fetch camera frames as compressed MJPG and decode them on the engine thread pool instead of
+  // the capture thread, so high resolution cameras can reach their full frame rate
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  bool ParallelMJPEGDecode;
+
+  // Maximum number of frames being decoded at the same time (ParallelMJPEGDecode)
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture",
+            meta = (ClampMin = "1"))
+  int32 MaxDecodesInFlight;
+
+  // How video files are paced. With FileTimestamps, files play in real time according to
+  // CAP_PROP_POS_MSEC / CAP_PROP_FPS (RefreshRate only stands in if the file has no frame rate);
+  // frames that are already late, or that would be replaced in the queue before they are popped,
+  // are grabbed but never retrieved, converted, resized or processed. Cameras are always read at
+  // their own rate (at most RefreshRate).
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  ECVPlaybackPacing PlaybackPacing;
+
+  // Scrub-friendly playback of VideoFile: builds a frame index once (cached as <VideoFile>.cvindex)
+  // to seek by time, and keeps recently seeked frames decoded for scrubbing back and forth
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  bool EnableScrubbing;
+
+  // Number of decoded frames kept for scrubbing (EnableScrubbing)
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture",
+            meta = (ClampMin = "0"))
+  int32 FrameCacheSize;
+
+  // Seek targets at most this many frames ahead are read up to instead of seeking from the
+  // previous keyframe, 0 for one second of frames
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture",
+            meta = (ClampMin = "0"))
+  int32 MaxForwardGrabFrames;
+
+  // Number of frames of VideoFile, 0 until the frame index is ready (EnableScrubbing)
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  int32 FrameCount;
+
+  // Shows the frame with the given index (starting at 0) next, playback continues from there.
+  // Ignored for cameras.
+  UFUNCTION(BlueprintCallable, Category = "OpenCV|VideoCapture")
+  void SeekToFrame(int32 frameIndex);
+
+  // Shows the frame at the given time of the video file next, playback continues from there.
+  // Seeks are frame accurate once the frame index is ready, until then the nominal frame rate is
+  // used. Ignored for cameras.
+  UFUNCTION(BlueprintCallable, Category = "OpenCV|VideoCapture")
+  void SeekToTime(float seconds);
+
+  // Pauses or resumes playback, seeks are still shown while paused
+  UFUNCTION(BlueprintCallable, Category = "OpenCV|VideoCapture")
+  void SetPaused(bool paused);
+
+  // Number of late video file frames that were grabbed but not retrieved (FileTimestamps pacing)
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  int32 SkippedFrames;
+
+  // How frames are queued between the capture thread and Tick, i.e. lowest latency (LatestOnly)
+  // or no frame loss (FifoBackpressure)
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  ECVFrameQueuePolicy FrameQueuePolicy;
+
+  // Maximum number of frames waiting for Tick
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture",
+            meta = (ClampMin = "1"))
+  int32 FrameQueueCapacity;
+
+  // Number of frames dropped by the queue policy since the stream was opened
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  int32 DroppedFrames;
+
+  // Number of captured frames waiting to be picked up
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  int32 QueueDepth;
+
+  // Number of frame objects that are handed out to consumers, allocated once in BeginPlay
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture",
+            meta = (ClampMin = "2"))
+  int32 FramePoolSize;
+
+  // If set, every delivered frame stays untouched until it is handed back with ReleaseFrame, and
+  // no new frames are delivered while all frames of the pool are in use. Otherwise the previous
+  // frame is released automatically when the next one is delivered.
+  UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "OpenCV|VideoCapture")
+  bool ExplicitFrameRelease;
+
+  // Number of frames of the pool that are currently held by consumers
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  int32 FramesInUse;
+
+  // Hands a delivered frame back to the pool. Its matrix is emptied, so the capture thread can
+  // reuse the image buffer.
+  UFUNCTION(BlueprintCallable, Category = "OpenCV|VideoCapture")
+  void ReleaseFrame(UCVUMat* releasedFrame);
+
+  // Where the most recently displayed frame spent its time between the camera and RTVideoTexture.
+  // Reported one or two ticks after the frame, once the render thread has updated the texture.
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  FCVFrameLatency FrameLatency;
+
+  // Rolling percentiles of FrameLatency over the last 256 displayed frames
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  FCVFrameLatency FrameLatencyP50;
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  FCVFrameLatency FrameLatencyP95;
+  UPROPERTY(BlueprintReadOnly, Category = "OpenCV|VideoCapture")
+  FCVFrameLatency FrameLatencyP99;
+
+  // The refresh timer (unused, frames are paced by the capture thread)
   UPROPERTY(BlueprintReadWrite, Category = "OpenCV|VideoCapture")
   float RefreshTimer;
 
-  // OpenCV fields
+  // The most recently delivered frame, nullptr until the first frame arrives
   UPROPERTY(BlueprintReadWrite, Category = "OpenCV|VideoCapture")
   UCVUMat* frame;
 
 public:
+  // The stream is read on a capture thread, only access it while that is not running
   cv::VideoCapture* stream;
   cv::Size* size;
 
-  // OpenCV prototypes
-  void UpdateFrame();
+  // Picks up the next frame from the capture thread, returns false if there is no new one
+  bool UpdateFrame();
 
   // TODO: refactor into a BP-callable
   void UpdateTexture();
@@ -112,4 +228,14 @@ public:
   TArray<FColor> Data;
 
 protected:
+  // Reads the stream on a background thread
+  FCVCaptureWorker* CaptureWorker;
+
+  // Shared with the render thread, which reports when frame uploads have executed
+  TSharedPtr<FCVLatencyTracker, ESPMode::ThreadSafe> LatencyTracker;
+
+  // The frame objects that are handed out, and the indices of those not held by a consumer
+  UPROPERTY()
+  TArray<UCVUMat*> FramePool;
+  TArray<int32> FreeFrames;
 };
@@ -0,0 +1,9 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Same values as the UENUM in Source/OpenCV/Classes/CVCaptureTypes.h
+enum class ECVFrameQueuePolicy : uint8 { LatestOnly, FifoBackpressure, FifoDropOldest };
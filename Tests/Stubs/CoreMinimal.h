@@ -0,0 +1,31 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+// Minimal stand-ins for the engine types CVFrameRing.h uses, so the ring can be built and run
+// without the engine (see CVFrameRingStressTest.cpp)
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+typedef int32_t int32;
+typedef uint8_t uint8;
+
+#define INDEX_NONE -1
+
+struct FMath {
+  template <typename T> static T Max(T A, T B) { return A > B ? A : B; }
+};
+
+template <typename T> class TArray {
+public:
+  void SetNum(int32 Num) { Data.resize(Num); }
+  int32 Num() const { return static_cast<int32>(Data.size()); }
+  T& operator[](int32 Index) { return Data[Index]; }
+  const T& operator[](int32 Index) const { return Data[Index]; }
+
+private:
+  std::vector<T> Data;
+};
@@ -0,0 +1,10 @@
+// (c) 2019 Technical University of Munich
+// Jakob Weiss <jakob.weiss@tum.de>
+
+#pragma once
+
+#include <thread>
+
+struct FPlatformProcess {
+  static void Yield() { std::this_thread::yield(); }
+};